@@ -5,19 +5,200 @@
 #include <unordered_set>
 #include <chrono>
 #include <algorithm>
+#include <stdexcept>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <unordered_map>
+#include <cstdio>
+#include <cmath>
+#include <limits>
 
+class IntCounters
+{
+private:
+    std::vector<int> counts = {};
+public:
+    explicit IntCounters(size_t size): counts(size, 0) {}
+
+    int get(size_t index) const
+    {
+        return counts[index];
+    }
+
+    // Returns the count before the increment, i.e. the number of new conflicting pairs
+    int increment(size_t index)
+    {
+        return counts[index]++;
+    }
+
+    // Returns the count after the decrement, i.e. the number of removed conflicting pairs
+    int decrement(size_t index)
+    {
+        return --counts[index];
+    }
+
+    void clear()
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+    }
+};
+
+// One byte per counter. Counts that reach SATURATED keep the rest in a side table,
+// which stays empty on every board the searches actually produce.
+class CompactCounters
+{
+private:
+    static const uint8_t SATURATED = UINT8_MAX;
+    std::vector<uint8_t> counts = {};
+    std::unordered_map<size_t, int> overflow = {};
+public:
+    explicit CompactCounters(size_t size): counts(size, 0) {}
+
+    int get(size_t index) const
+    {
+        uint8_t count = counts[index];
+        if (count != SATURATED)
+        {
+            return count;
+        }
+        auto it = overflow.find(index);
+        return SATURATED + (it == overflow.end() ? 0 : it->second);
+    }
+
+    int increment(size_t index)
+    {
+        uint8_t& count = counts[index];
+        if (count != SATURATED)
+        {
+            return count++;
+        }
+        return SATURATED + overflow[index]++;
+    }
+
+    int decrement(size_t index)
+    {
+        uint8_t& count = counts[index];
+        if (count != SATURATED)
+        {
+            return --count;
+        }
+        auto it = overflow.find(index);
+        if (it == overflow.end())
+        {
+            return --count;
+        }
+        int extra = --it->second;
+        if (extra == 0)
+        {
+            overflow.erase(it);
+        }
+        return SATURATED + extra;
+    }
+
+    void clear()
+    {
+        std::fill(counts.begin(), counts.end(), 0);
+        overflow.clear();
+    }
+};
+
+const uint8_t CompactCounters::SATURATED;
+
+// Queens pinned to given squares, together with the columns and rows left to the search.
+// Without pinned queens nothing is stored and the free columns and rows are the identity.
+class FixedPlacement
+{
+private:
+    int n;
+    std::vector<std::pair<int, int>> queens = {};
+    std::vector<int> freeColumns = {};
+    std::vector<int> freeRows = {};
+public:
+    FixedPlacement(int n, const std::vector<std::pair<int, int>>& queens): n(n), queens(queens)
+    {
+        if (queens.empty())
+        {
+            return;
+        }
+        std::vector<char> isColumnUsed(n, 0);
+        std::vector<char> isRowUsed(n, 0);
+        std::vector<char> isMainDiagonalUsed(2 * n - 1, 0);
+        std::vector<char> isSecondaryDiagonalUsed(2 * n - 1, 0);
+        for (const auto& queen : queens)
+        {
+            int column = queen.first;
+            int row = queen.second;
+            if (column < 0 || column >= n || row < 0 || row >= n)
+            {
+                throw std::invalid_argument("Fixed queen outside of the board");
+            }
+            if (isColumnUsed[column] || isRowUsed[row] ||
+                isMainDiagonalUsed[column + row] || isSecondaryDiagonalUsed[column - row + (n - 1)])
+            {
+                throw std::invalid_argument("Fixed queens attack each other");
+            }
+            isColumnUsed[column] = 1;
+            isRowUsed[row] = 1;
+            isMainDiagonalUsed[column + row] = 1;
+            isSecondaryDiagonalUsed[column - row + (n - 1)] = 1;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (!isColumnUsed[i])
+            {
+                freeColumns.push_back(i);
+            }
+            if (!isRowUsed[i])
+            {
+                freeRows.push_back(i);
+            }
+        }
+    }
+
+    const std::vector<std::pair<int, int>>& getQueens() const
+    {
+        return queens;
+    }
+
+    int getFreeCount() const
+    {
+        return n - static_cast<int>(queens.size());
+    }
+
+    int getFreeColumn(int index) const
+    {
+        return queens.empty() ? index : freeColumns[index];
+    }
+
+    int getFreeRow(int index) const
+    {
+        return queens.empty() ? index : freeRows[index];
+    }
+};
+
+template <typename Counters>
 class Board
 {
 private:
     int n;
     int collisions;
-    std::vector<int> queensPositions = {};
-    std::vector<int> queensPerRow = {};
-    std::vector<int> queensPerMainDiagonal = {};
-    std::vector<int> queensPerSecondaryDiagonal = {};
+    std::mt19937 rng;
+    const FixedPlacement& placement;
+    std::vector<int32_t> queensPositions = {};
+    Counters queensPerRow;
+    Counters queensPerMainDiagonal;
+    Counters queensPerSecondaryDiagonal;
 public:
-    explicit Board(int n): n(n), queensPositions(n, -1), collisions(0), queensPerRow(n, 0),
-                          queensPerMainDiagonal(2 * n - 1, 0), queensPerSecondaryDiagonal(2 * n - 1, 0)
+    Board(int n, unsigned int seed, const FixedPlacement& placement): n(n), collisions(0), rng(seed), placement(placement),
+                                                                      queensPositions(n, -1), queensPerRow(n),
+                                                                      queensPerMainDiagonal(2 * n - 1),
+                                                                      queensPerSecondaryDiagonal(2 * n - 1)
+    {
+        reset();
+    }
+
+    void reset()
     {
         initializeField();
         initializeCollisions();
@@ -42,7 +223,7 @@ public:
         std::cout<< std::endl;
     }
 
-    const std::vector<int>& getQueensPositions()
+    const std::vector<int32_t>& getQueensPositions()
     {
         return queensPositions;
     }
@@ -53,12 +234,24 @@ public:
     }
 
     int getColumnWithMostCollisions()
+    {
+        static const std::vector<long long> noTabu = {};
+        return getColumnWithMostCollisions(noTabu, 0);
+    }
+
+    // Columns whose tabu tenure has not expired at this iteration are skipped, unless all of them are
+    int getColumnWithMostCollisions(const std::vector<long long>& tabuUntil, long long iteration)
     {
         int maxConflicts = -1;
         std::vector<int> columnsWithMaxConflicts = {};
-        for (int column = 0; column < n; column++)
+        for (int index = 0; index < placement.getFreeCount(); index++)
         {
-            int conflicts = numConflicts(column, queensPositions[column]);\
+            int column = placement.getFreeColumn(index);
+            if (!tabuUntil.empty() && tabuUntil[column] > iteration)
+            {
+                continue;
+            }
+            int conflicts = numConflicts(column, queensPositions[column]);
 
             if (conflicts > maxConflicts)
             {
@@ -70,8 +263,11 @@ public:
                 columnsWithMaxConflicts.push_back(column);
             }
         }
-        return columnsWithMaxConflicts[rand() % columnsWithMaxConflicts.size()];
-
+        if (columnsWithMaxConflicts.empty())
+        {
+            return getColumnWithMostCollisions();
+        }
+        return columnsWithMaxConflicts[getRandomIndex(columnsWithMaxConflicts.size())];
     }
 
     void updateCollisions()
@@ -79,7 +275,7 @@ public:
         int currCollisions = 0;
         for(int row = 0; row < n; row++)
         {
-            int queensCount = queensPerRow[row];
+            int queensCount = queensPerRow.get(row);
             if (queensCount > 1)
             {
                 currCollisions += (queensCount * (queensCount - 1)) / 2;
@@ -88,8 +284,8 @@ public:
 
         for (int d = 0; d < 2 * n - 1; d++)
         {
-            int queensCountMainDiagonal = queensPerMainDiagonal[d];
-            int queensCountSecondaryDiagonal = queensPerSecondaryDiagonal[d];
+            int queensCountMainDiagonal = queensPerMainDiagonal.get(d);
+            int queensCountSecondaryDiagonal = queensPerSecondaryDiagonal.get(d);
 
             if (queensCountMainDiagonal > 1)
             {
@@ -105,43 +301,70 @@ public:
     }
 
     void setLeastConflictedRowForColumnQueen(int column)
+    {
+        moveQueen(column, getLeastConflictedRow(column));
+    }
+
+    // Metropolis step: the least conflicted row is taken if it improves, otherwise a random
+    // free row is accepted with probability exp(-delta / temperature)
+    void setAnnealedRowForColumnQueen(int column, double temperature)
+    {
+        int currentConflicts = numConflicts(column, queensPositions[column]);
+        int leastConflictRow = getLeastConflictedRow(column);
+        if (numConflicts(column, leastConflictRow) < currentConflicts)
+        {
+            moveQueen(column, leastConflictRow);
+            return;
+        }
+        int row = placement.getFreeRow(getRandomIndex(placement.getFreeCount()));
+        int delta = numConflicts(column, row) - currentConflicts;
+        if (delta <= 0 || std::uniform_real_distribution<double>(0.0, 1.0)(rng) < std::exp(-delta / temperature))
+        {
+            moveQueen(column, row);
+        }
+    }
+
+private:
+    void moveQueen(int column, int row)
     {
         int previousRow = queensPositions[column];
-        int leastConflictIndex = getLeastConflictedRow(column);
-        queensPositions[column] = leastConflictIndex;
-        if (leastConflictIndex == previousRow)
+        queensPositions[column] = row;
+        if (row == previousRow)
         {
             return;
         }
         int conflictDiff = 0;
-        queensPerRow[previousRow]--;
-        conflictDiff -= queensPerRow[previousRow];
-        queensPerMainDiagonal[column + previousRow]--;
-        conflictDiff -= queensPerMainDiagonal[column + previousRow];
-        queensPerSecondaryDiagonal[column - previousRow + (n - 1)]--;
-        conflictDiff -= queensPerSecondaryDiagonal[column - previousRow + (n - 1)];
-        queensPerRow[leastConflictIndex]++;
-        conflictDiff += queensPerRow[leastConflictIndex] - 1;
-        queensPerMainDiagonal[column + leastConflictIndex]++;
-        conflictDiff += queensPerMainDiagonal[column + leastConflictIndex] - 1;
-        queensPerSecondaryDiagonal[column - leastConflictIndex + (n - 1)]++;
-        conflictDiff += queensPerSecondaryDiagonal[column - leastConflictIndex + (n - 1)] - 1;
+        conflictDiff -= queensPerRow.decrement(previousRow);
+        conflictDiff -= queensPerMainDiagonal.decrement(column + previousRow);
+        conflictDiff -= queensPerSecondaryDiagonal.decrement(column - previousRow + (n - 1));
+        conflictDiff += queensPerRow.increment(row);
+        conflictDiff += queensPerMainDiagonal.increment(column + row);
+        conflictDiff += queensPerSecondaryDiagonal.increment(column - row + (n - 1));
 
         collisions += conflictDiff;
     }
 
-private:
+    size_t getRandomIndex(size_t size)
+    {
+        return std::uniform_int_distribution<size_t>(0, size - 1)(rng);
+    }
+
     void initializeField()
     {
-        std::vector<int> rows(n, 0);
-        for (int i = 0; i < n; i++)
+        int freeCount = placement.getFreeCount();
+        std::vector<int> rows(freeCount, 0);
+        for (int i = 0; i < freeCount; i++)
+        {
+            rows[i] = placement.getFreeRow(i);
+        }
+        std::shuffle(rows.begin(), rows.end(), rng);
+        for (int i = 0; i < freeCount; i++)
         {
-            rows[i] = i;
+            queensPositions[placement.getFreeColumn(i)] = rows[i];
         }
-        std::shuffle(rows.begin(), rows.end(), std::mt19937(std::random_device()()));
-        for(int column = 0; column < n; column++)
+        for (const auto& queen : placement.getQueens())
         {
-            queensPositions[column] = rows[column];
+            queensPositions[queen.first] = queen.second;
         }
     }
 
@@ -150,22 +373,24 @@ private:
         bool isQueenHere = (queensPositions[column] == row);
         if (!isQueenHere)
         {
-            return queensPerRow[row] +
-                   queensPerMainDiagonal[column + row] +
-                   queensPerSecondaryDiagonal[column - row + (n - 1)];
+            return queensPerRow.get(row) +
+                   queensPerMainDiagonal.get(column + row) +
+                   queensPerSecondaryDiagonal.get(column - row + (n - 1));
         }
-        return (queensPerRow[row] - 1) +
-               (queensPerMainDiagonal[column + row] - 1) +
-               (queensPerSecondaryDiagonal[column - row + (n - 1)] - 1);
+        return (queensPerRow.get(row) - 1) +
+               (queensPerMainDiagonal.get(column + row) - 1) +
+               (queensPerSecondaryDiagonal.get(column - row + (n - 1)) - 1);
     }
 
 
     int getLeastConflictedRow(int column)
     {
         std::vector<int> leastConflictRows = {};
-        int leastConflicts = n * n;
-        for(int j = 0; j < n; j++)
+        int leastConflicts = std::numeric_limits<int>::max();
+        // A row taken by a pinned queen always conflicts, so only the free rows are candidates
+        for (int index = 0; index < placement.getFreeCount(); index++)
         {
+            int j = placement.getFreeRow(index);
             int conflicts = numConflicts(column, j);
             if (conflicts < leastConflicts)
             {
@@ -177,89 +402,958 @@ private:
                 leastConflictRows.push_back(j);
             }
         }
-        return leastConflictRows[rand() % leastConflictRows.size()];
+        return leastConflictRows[getRandomIndex(leastConflictRows.size())];
     }
 
     void initializeCollisions()
     {
-        for(int row = 0; row < n; row++)
+        queensPerRow.clear();
+        queensPerMainDiagonal.clear();
+        queensPerSecondaryDiagonal.clear();
+        for (int column = 0; column < n; column++)
         {
-            int queensCount = 0;
-            for (int col = 0; col < n; col++)
+            int row = queensPositions[column];
+            queensPerRow.increment(row);
+            queensPerMainDiagonal.increment(column + row);
+            queensPerSecondaryDiagonal.increment(column - row + (n - 1));
+        }
+
+        updateCollisions();
+    }
+};
+
+template <typename Counters>
+class PermutationBoard
+{
+private:
+    static const int FREE_TAIL = 100;
+    int n;
+    int collisions;
+    std::mt19937 rng;
+    const FixedPlacement& placement;
+    std::vector<int32_t> queensPositions = {};
+    Counters queensPerMainDiagonal;
+    Counters queensPerSecondaryDiagonal;
+public:
+    PermutationBoard(int n, unsigned int seed, const FixedPlacement& placement): n(n), collisions(0), rng(seed),
+                                                                                 placement(placement),
+                                                                                 queensPositions(n, -1),
+                                                                                 queensPerMainDiagonal(2 * n - 1),
+                                                                                 queensPerSecondaryDiagonal(2 * n - 1)
+    {
+        reset();
+    }
+
+    int getCollisions() const
+    {
+        return collisions;
+    }
+
+    const std::vector<int32_t>& getQueensPositions() const
+    {
+        return queensPositions;
+    }
+
+    int getSize() const
+    {
+        return n;
+    }
+
+    bool isAttacked(int column) const
+    {
+        int row = queensPositions[column];
+        return queensPerMainDiagonal.get(column + row) > 1 ||
+               queensPerSecondaryDiagonal.get(column - row + (n - 1)) > 1;
+    }
+
+    const FixedPlacement& getPlacement() const
+    {
+        return placement;
+    }
+
+    // Only free columns are returned, pinned queens never take part in a swap
+    int getRandomColumn()
+    {
+        return placement.getFreeColumn(std::uniform_int_distribution<int>(0, placement.getFreeCount() - 1)(rng));
+    }
+
+    // Swaps the rows of the two queens and returns the change in collisions.
+    // Rows stay a permutation, so only the diagonal counters are touched.
+    int swapQueens(int first, int second)
+    {
+        int firstRow = queensPositions[first];
+        int secondRow = queensPositions[second];
+        int conflictDiff = 0;
+        conflictDiff -= removeQueen(first, firstRow);
+        conflictDiff -= removeQueen(second, secondRow);
+        conflictDiff += addQueen(first, secondRow);
+        conflictDiff += addQueen(second, firstRow);
+        queensPositions[first] = secondRow;
+        queensPositions[second] = firstRow;
+
+        collisions += conflictDiff;
+        return conflictDiff;
+    }
+
+    // Greedy random permutation: every queen but the last few is placed on free diagonals if a
+    // random swap finds such a row, which leaves only O(1) collisions for the search to fix.
+    void reset()
+    {
+        queensPerMainDiagonal.clear();
+        queensPerSecondaryDiagonal.clear();
+        collisions = 0;
+        for (const auto& queen : placement.getQueens())
+        {
+            queensPositions[queen.first] = queen.second;
+            collisions += addQueen(queen.first, queen.second);
+        }
+        int freeCount = placement.getFreeCount();
+        for (int index = 0; index < freeCount; index++)
+        {
+            queensPositions[placement.getFreeColumn(index)] = placement.getFreeRow(index);
+        }
+
+        int greedyColumns = freeCount - FREE_TAIL;
+        for (int index = 0; index < freeCount; index++)
+        {
+            int column = placement.getFreeColumn(index);
+            int attempts = index < greedyColumns ? 3 * (freeCount - index) : 1;
+            for (int attempt = 0; attempt < attempts; attempt++)
             {
-                if (queensPositions[col] == row)
+                int other = placement.getFreeColumn(std::uniform_int_distribution<int>(index, freeCount - 1)(rng));
+                std::swap(queensPositions[column], queensPositions[other]);
+                int row = queensPositions[column];
+                if (queensPerMainDiagonal.get(column + row) == 0 &&
+                    queensPerSecondaryDiagonal.get(column - row + (n - 1)) == 0)
                 {
-                    queensCount++;
+                    break;
                 }
             }
-            queensPerRow[row] = queensCount;
+            collisions += addQueen(column, queensPositions[column]);
         }
+    }
 
-        for (int d = 0; d < 2 * n - 1; d++)
+private:
+    int addQueen(int column, int row)
+    {
+        int added = queensPerMainDiagonal.increment(column + row);
+        added += queensPerSecondaryDiagonal.increment(column - row + (n - 1));
+        return added;
+    }
+
+    int removeQueen(int column, int row)
+    {
+        int removed = queensPerMainDiagonal.decrement(column + row);
+        removed += queensPerSecondaryDiagonal.decrement(column - row + (n - 1));
+        return removed;
+    }
+};
+
+template <typename Counters>
+const int PermutationBoard<Counters>::FREE_TAIL;
+
+enum class SolverMode
+{
+    MIN_CONFLICTS,
+    SWAP,
+    COUNT,
+    CONSTRUCT
+};
+
+static SolverMode fromString(const std::string& str)
+{
+    if (str == "min-conflicts")
+        return SolverMode::MIN_CONFLICTS;
+    else if (str == "swap")
+        return SolverMode::SWAP;
+    else if (str == "count")
+        return SolverMode::COUNT;
+    else if (str == "construct")
+        return SolverMode::CONSTRUCT;
+    else
+        throw std::invalid_argument("Invalid SolverMode string");
+}
+
+enum class EscapeStrategy
+{
+    RESTART,
+    ANNEALING,
+    TABU
+};
+
+static EscapeStrategy escapeFromString(const std::string& str)
+{
+    if (str == "restart")
+        return EscapeStrategy::RESTART;
+    else if (str == "anneal")
+        return EscapeStrategy::ANNEALING;
+    else if (str == "tabu")
+        return EscapeStrategy::TABU;
+    else
+        throw std::invalid_argument("Invalid EscapeStrategy string");
+}
+
+struct SolverSettings
+{
+    SolverMode mode = SolverMode::MIN_CONFLICTS;
+    EscapeStrategy escape = EscapeStrategy::RESTART;
+    double initialTemperature = 2.0;
+    double minTemperature = 0.05;
+    double coolingRate = 0.999;
+    int tabuTenure = 10;
+    long long maxIterationsMult = 50000;
+    int restartMult = 3;
+    bool collectTelemetry = false;
+    bool isCompact = false;
+    int threadsCount = 1;
+    unsigned int seed = 0;
+    bool shouldPrint = false;
+};
+
+// Collision samples are thinned out and taken half as often whenever the buffer fills up,
+// so the trace covers the whole search in at most MAX_SAMPLES points.
+struct SearchStats
+{
+    static const size_t MAX_SAMPLES = 64;
+
+    long long iterations = 0;
+    int restarts = 0;
+    bool solved = false;
+    long long columnSelectionNs = 0;
+    long long rowSelectionNs = 0;
+    long long firstZeroMs = -1;
+    long long sampleInterval = 1;
+    std::vector<std::pair<long long, int>> collisionSamples = {};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    void sampleCollisions(long long iteration, int collisions)
+    {
+        if (iteration % sampleInterval != 0)
+        {
+            return;
+        }
+        if (collisionSamples.size() == MAX_SAMPLES)
         {
-            int queensCountMainDiagonal = 0;
-            int queensCountSecondaryDiagonal = 0;
-            for (int col = 0; col < n; col++)
+            size_t kept = 0;
+            for (size_t i = 0; i < collisionSamples.size(); i += 2)
             {
-                int rowMainDiagonal = d - col;
-                if (rowMainDiagonal >= 0 && rowMainDiagonal < n && queensPositions[col] == rowMainDiagonal)
-                {
-                    queensCountMainDiagonal++;
-                }
-
-                int rowSecondaryDiagonal = col - (d - (n - 1));
-                if (rowSecondaryDiagonal >= 0 && rowSecondaryDiagonal < n && queensPositions[col] == rowSecondaryDiagonal)
-                {
-                    queensCountSecondaryDiagonal++;
-                }
+                collisionSamples[kept++] = collisionSamples[i];
+            }
+            collisionSamples.resize(kept);
+            sampleInterval *= 2;
+            if (iteration % sampleInterval != 0)
+            {
+                return;
             }
-            queensPerMainDiagonal[d] = queensCountMainDiagonal;
-            queensPerSecondaryDiagonal[d] = queensCountSecondaryDiagonal;
         }
+        collisionSamples.emplace_back(iteration, collisions);
+    }
 
-        updateCollisions();
+    void recordFirstZero()
+    {
+        if (firstZeroMs < 0)
+        {
+            firstZeroMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+        }
+    }
+};
+
+const size_t SearchStats::MAX_SAMPLES;
+
+// Adds the lifetime of the scope to the counter, reading the clock only when enabled
+class ScopedTimer
+{
+private:
+    long long& totalNs;
+    bool isEnabled;
+    std::chrono::steady_clock::time_point start;
+public:
+    ScopedTimer(long long& totalNs, bool isEnabled): totalNs(totalNs), isEnabled(isEnabled)
+    {
+        if (isEnabled)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer()
+    {
+        if (isEnabled)
+        {
+            totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+        }
     }
 };
 
 class Solver
 {
 public:
-    static std::vector<int> solve(Board& board, bool shouldPrint)
+    template <typename Counters>
+    static std::vector<int> solve(Board<Counters>& board, const SolverSettings& settings, const std::atomic<bool>& stop,
+                                  SearchStats& stats)
     {
-        const int MAX_ITERATIONS_MULT = 50000;
-        int MAX_ITERATIONS = MAX_ITERATIONS_MULT * board.getSize();
-        int lastBetteredIteration = -1;
+        long long MAX_ITERATIONS = settings.maxIterationsMult * board.getSize();
+        long long lastBetteredIteration = -1;
         int lastCollisions = board.getCollisions();
-        for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++)
+        double temperature = settings.initialTemperature;
+        std::vector<long long> tabuUntil = {};
+        if (settings.escape == EscapeStrategy::TABU)
         {
-            if (shouldPrint)
+            tabuUntil.assign(board.getSize(), -1);
+        }
+        for (long long iteration = 0; iteration < MAX_ITERATIONS; iteration++)
+        {
+            if (stop.load(std::memory_order_relaxed))
+            {
+                return {};
+            }
+            stats.iterations++;
+
+            if (settings.shouldPrint)
             {
                 board.printBoard();
             }
 
+            if (settings.collectTelemetry)
+            {
+                stats.sampleCollisions(iteration, board.getCollisions());
+            }
             if (board.getCollisions() == 0)
             {
+                stats.recordFirstZero();
                 return board.getQueensPositions();
             }
 
-            int randomColumn = board.getColumnWithMostCollisions();
-            board.setLeastConflictedRowForColumnQueen(randomColumn);
+            int randomColumn;
+            {
+                ScopedTimer timer(stats.columnSelectionNs, settings.collectTelemetry);
+                randomColumn = settings.escape == EscapeStrategy::TABU
+                        ? board.getColumnWithMostCollisions(tabuUntil, iteration)
+                        : board.getColumnWithMostCollisions();
+            }
+            {
+                ScopedTimer timer(stats.rowSelectionNs, settings.collectTelemetry);
+                if (settings.escape == EscapeStrategy::ANNEALING)
+                {
+                    board.setAnnealedRowForColumnQueen(randomColumn, temperature);
+                    temperature = std::max(settings.minTemperature, temperature * settings.coolingRate);
+                }
+                else
+                {
+                    board.setLeastConflictedRowForColumnQueen(randomColumn);
+                }
+            }
+            if (settings.escape == EscapeStrategy::TABU)
+            {
+                tabuUntil[randomColumn] = iteration + settings.tabuTenure;
+            }
+
             if (board.getCollisions() < lastCollisions)
             {
                 lastBetteredIteration = iteration;
                 lastCollisions = board.getCollisions();
             }
-            else if (iteration - lastBetteredIteration > 3 * board.getSize())
+            else if (iteration - lastBetteredIteration > (long long)settings.restartMult * board.getSize())
             {
-                // Reinitialize the board if no progress is made
-                board = Board(board.getSize());
+                if (settings.escape == EscapeStrategy::RESTART)
+                {
+                    // Reinitialize the board if no progress is made
+                    board.reset();
+                    stats.restarts++;
+                }
+                else if (settings.escape == EscapeStrategy::ANNEALING)
+                {
+                    // Reheat instead, the current placement is kept
+                    temperature = settings.initialTemperature;
+                    stats.restarts++;
+                }
+                // Progress is measured from the current placement from now on
                 lastBetteredIteration = iteration;
+                lastCollisions = board.getCollisions();
             }
         }
         return {};
     }
+
+    // In the telemetry, rescanning for attacked columns counts as column selection and trying swaps as row selection
+    template <typename Counters>
+    static std::vector<int> solveBySwaps(PermutationBoard<Counters>& board, const SolverSettings& settings,
+                                         const std::atomic<bool>& stop, SearchStats& stats)
+    {
+        const int MAX_RESTARTS = 1000;
+        int n = board.getSize();
+        std::vector<int> attackedColumns = {};
+        std::vector<int> nextAttackedColumns = {};
+        std::vector<char> isQueued(n, 0);
+        for (int restart = 0; restart < MAX_RESTARTS; restart++)
+        {
+            long long stepsWithoutProgress = 0;
+            long long maxStepsWithoutProgress = (long long)settings.restartMult * n + 100;
+            while (board.getCollisions() > 0 && stepsWithoutProgress < maxStepsWithoutProgress)
+            {
+                if (attackedColumns.empty())
+                {
+                    ScopedTimer timer(stats.columnSelectionNs, settings.collectTelemetry);
+                    std::fill(isQueued.begin(), isQueued.end(), 0);
+                    const FixedPlacement& placement = board.getPlacement();
+                    for (int index = 0; index < placement.getFreeCount(); index++)
+                    {
+                        int column = placement.getFreeColumn(index);
+                        if (board.isAttacked(column))
+                        {
+                            attackedColumns.push_back(column);
+                            isQueued[column] = 1;
+                        }
+                    }
+                }
+
+                for (int column : attackedColumns)
+                {
+                    isQueued[column] = 0;
+                }
+                for (int column : attackedColumns)
+                {
+                    if (stop.load(std::memory_order_relaxed))
+                    {
+                        return {};
+                    }
+                    if (!board.isAttacked(column))
+                    {
+                        continue;
+                    }
+                    if (settings.collectTelemetry)
+                    {
+                        stats.sampleCollisions(stats.iterations, board.getCollisions());
+                    }
+                    stats.iterations++;
+                    ScopedTimer timer(stats.rowSelectionNs, settings.collectTelemetry);
+                    int other = board.getRandomColumn();
+                    if (other != column && board.swapQueens(column, other) < 0)
+                    {
+                        stepsWithoutProgress = 0;
+                        if (board.isAttacked(other) && !isQueued[other])
+                        {
+                            nextAttackedColumns.push_back(other);
+                            isQueued[other] = 1;
+                        }
+                        if (board.getCollisions() == 0)
+                        {
+                            stats.recordFirstZero();
+                            return board.getQueensPositions();
+                        }
+                    }
+                    else
+                    {
+                        if (other != column)
+                        {
+                            board.swapQueens(column, other);
+                        }
+                        stepsWithoutProgress++;
+                    }
+                    if (board.isAttacked(column) && !isQueued[column])
+                    {
+                        nextAttackedColumns.push_back(column);
+                        isQueued[column] = 1;
+                    }
+                }
+                std::swap(attackedColumns, nextAttackedColumns);
+                nextAttackedColumns.clear();
+            }
+            if (board.getCollisions() == 0)
+            {
+                stats.recordFirstZero();
+                return board.getQueensPositions();
+            }
+            // Only improving swaps are taken, so a local minimum needs a fresh start
+            board.reset();
+            stats.restarts++;
+            attackedColumns.clear();
+        }
+        return {};
+    }
+
+    template <typename Counters>
+    static std::vector<int> solveWithMode(int n, const FixedPlacement& placement, const SolverSettings& settings,
+                                          unsigned int seed, const std::atomic<bool>& stop, SearchStats& stats)
+    {
+        if (settings.mode == SolverMode::SWAP)
+        {
+            PermutationBoard<Counters> board(n, seed, placement);
+            return solveBySwaps(board, settings, stop, stats);
+        }
+        Board<Counters> board(n, seed, placement);
+        return solve(board, settings, stop, stats);
+    }
+
+    // Independent searches with their own RNG streams, the first one to reach zero collisions stops the rest
+    static std::vector<int> solveParallel(int n, const FixedPlacement& placement, const SolverSettings& settings,
+                                          std::vector<SearchStats>& stats)
+    {
+        int threadsCount = settings.threadsCount;
+        std::atomic<bool> stop(false);
+        std::vector<int> solution;
+        stats.assign(threadsCount, SearchStats());
+        auto runWorker = [&](int worker)
+        {
+            std::seed_seq workerSeed{settings.seed, static_cast<unsigned int>(worker)};
+            std::vector<unsigned int> workerSeedValue(1);
+            workerSeed.generate(workerSeedValue.begin(), workerSeedValue.end());
+
+            std::vector<int> result = settings.isCompact
+                    ? solveWithMode<CompactCounters>(n, placement, settings, workerSeedValue[0], stop, stats[worker])
+                    : solveWithMode<IntCounters>(n, placement, settings, workerSeedValue[0], stop, stats[worker]);
+            if (!result.empty() && !stop.exchange(true))
+            {
+                stats[worker].solved = true;
+                solution = std::move(result);
+            }
+        };
+
+        if (threadsCount == 1)
+        {
+            runWorker(0);
+            return solution;
+        }
+        std::vector<std::thread> workers;
+        for (int worker = 0; worker < threadsCount; worker++)
+        {
+            workers.emplace_back(runWorker, worker);
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        return solution;
+    }
+};
+
+SolverMode getSolverMode()
+{
+    const char* env_p = std::getenv("FMI_QUEENS_MODE");
+    return env_p != nullptr ? fromString(env_p) : SolverMode::MIN_CONFLICTS;
+}
+
+// Independent O(n) check of a placement with fresh counters, shared with none of the solvers
+class SolutionVerifier
+{
+public:
+    static bool isValid(int n, const std::vector<int32_t>& solution, const FixedPlacement& placement)
+    {
+        if ((int)solution.size() != n)
+        {
+            return false;
+        }
+        std::vector<char> isRowUsed(n, 0);
+        std::vector<char> isMainDiagonalUsed(2 * n - 1, 0);
+        std::vector<char> isSecondaryDiagonalUsed(2 * n - 1, 0);
+        for (int column = 0; column < n; column++)
+        {
+            int row = solution[column];
+            if (row < 0 || row >= n || isRowUsed[row] ||
+                isMainDiagonalUsed[column + row] || isSecondaryDiagonalUsed[column - row + (n - 1)])
+            {
+                return false;
+            }
+            isRowUsed[row] = 1;
+            isMainDiagonalUsed[column + row] = 1;
+            isSecondaryDiagonalUsed[column - row + (n - 1)] = 1;
+        }
+        for (const auto& queen : placement.getQueens())
+        {
+            if (solution[queen.first] != queen.second)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Closed-form placement: even rows first, then odd rows, with the classical
+// adjustments for n mod 6 == 2 and n mod 6 == 3. Valid for n = 1 and every n >= 4.
+class ExplicitConstruction
+{
+public:
+    static std::vector<int32_t> place(int n)
+    {
+        std::vector<int32_t> evens = {};
+        std::vector<int32_t> odds = {};
+        for (int row = 2; row <= n; row += 2)
+        {
+            evens.push_back(row);
+        }
+        for (int row = 1; row <= n; row += 2)
+        {
+            odds.push_back(row);
+        }
+
+        if (n % 6 == 2 && n >= 6)
+        {
+            // 3, 1, 7, 9, ..., 5
+            std::swap(odds[0], odds[1]);
+            odds.erase(odds.begin() + 2);
+            odds.push_back(5);
+        }
+        else if (n % 6 == 3 && n >= 9)
+        {
+            // 4, 6, ..., 2 and 5, 7, ..., 1, 3
+            evens.erase(evens.begin());
+            evens.push_back(2);
+            odds.erase(odds.begin(), odds.begin() + 2);
+            odds.push_back(1);
+            odds.push_back(3);
+        }
+
+        std::vector<int32_t> solution = {};
+        solution.reserve(n);
+        for (int32_t row : evens)
+        {
+            solution.push_back(row - 1);
+        }
+        for (int32_t row : odds)
+        {
+            solution.push_back(row - 1);
+        }
+        return solution;
+    }
+};
+
+// Exact number of solutions by backtracking over column and diagonal bitmasks.
+// Mirroring the first row halves the work, and the first rows are split into tasks for a thread pool.
+class SolutionCounter
+{
+private:
+    struct Partial
+    {
+        uint32_t columns;
+        uint32_t mainDiagonals;
+        uint32_t secondaryDiagonals;
+        unsigned long long weight;
+    };
+
+    static const int MAX_SIZE = 32;
+    static const int MAX_SPLIT_ROWS = 3;
+    static const int TASKS_PER_THREAD = 16;
+public:
+    static unsigned long long count(int n, int threadsCount)
+    {
+        if (n <= 0 || n > MAX_SIZE)
+        {
+            throw std::invalid_argument("Counting supports 1 <= n <= 32");
+        }
+        uint32_t all = n == MAX_SIZE ? UINT32_MAX : (1u << n) - 1;
+        std::vector<Partial> tasks = getFirstRowTasks(n, all);
+        for (int row = 1; row < std::min(n, MAX_SPLIT_ROWS) && tasks.size() < (size_t)TASKS_PER_THREAD * threadsCount; row++)
+        {
+            tasks = expand(tasks, all);
+        }
+
+        std::atomic<size_t> nextTask(0);
+        std::vector<unsigned long long> workerCounts(threadsCount, 0);
+        auto runWorker = [&](int worker)
+        {
+            unsigned long long workerCount = 0;
+            for (size_t task = nextTask++; task < tasks.size(); task = nextTask++)
+            {
+                const Partial& partial = tasks[task];
+                workerCount += partial.weight * countFrom(all, partial.columns, partial.mainDiagonals,
+                                                          partial.secondaryDiagonals);
+            }
+            workerCounts[worker] = workerCount;
+        };
+
+        std::vector<std::thread> workers;
+        for (int worker = 1; worker < threadsCount; worker++)
+        {
+            workers.emplace_back(runWorker, worker);
+        }
+        runWorker(0);
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        unsigned long long total = 0;
+        for (unsigned long long workerCount : workerCounts)
+        {
+            total += workerCount;
+        }
+        return total;
+    }
+
+private:
+    static Partial place(const Partial& partial, uint32_t bit, uint32_t all, unsigned long long weight)
+    {
+        return {partial.columns | bit,
+                ((partial.mainDiagonals | bit) << 1) & all,
+                (partial.secondaryDiagonals | bit) >> 1,
+                weight};
+    }
+
+    // A solution with the first queen left of the middle mirrors one with it on the right.
+    // For odd n the middle column is handled the same way one row further down.
+    static std::vector<Partial> getFirstRowTasks(int n, uint32_t all)
+    {
+        std::vector<Partial> tasks = {};
+        Partial empty = {0, 0, 0, 1};
+        for (int column = 0; column < n / 2; column++)
+        {
+            tasks.push_back(place(empty, 1u << column, all, 2));
+        }
+        if (n % 2 == 1)
+        {
+            Partial middle = place(empty, 1u << (n / 2), all, 1);
+            if (n == 1)
+            {
+                tasks.push_back(middle);
+            }
+            uint32_t available = all & ~(middle.columns | middle.mainDiagonals | middle.secondaryDiagonals);
+            for (int column = 0; column < n / 2; column++)
+            {
+                uint32_t bit = 1u << column;
+                if (available & bit)
+                {
+                    tasks.push_back(place(middle, bit, all, 2));
+                }
+            }
+        }
+        return tasks;
+    }
+
+    static std::vector<Partial> expand(const std::vector<Partial>& partials, uint32_t all)
+    {
+        std::vector<Partial> expanded = {};
+        for (const Partial& partial : partials)
+        {
+            if (partial.columns == all)
+            {
+                expanded.push_back(partial);
+                continue;
+            }
+            uint32_t available = all & ~(partial.columns | partial.mainDiagonals | partial.secondaryDiagonals);
+            while (available != 0)
+            {
+                uint32_t bit = available & (~available + 1);
+                available ^= bit;
+                expanded.push_back(place(partial, bit, all, partial.weight));
+            }
+        }
+        return expanded;
+    }
+
+    static unsigned long long countFrom(uint32_t all, uint32_t columns, uint32_t mainDiagonals, uint32_t secondaryDiagonals)
+    {
+        if (columns == all)
+        {
+            return 1;
+        }
+        unsigned long long solutions = 0;
+        uint32_t available = all & ~(columns | mainDiagonals | secondaryDiagonals);
+        while (available != 0)
+        {
+            uint32_t bit = available & (~available + 1);
+            available ^= bit;
+            solutions += countFrom(all, columns | bit, ((mainDiagonals | bit) << 1) & all,
+                                   (secondaryDiagonals | bit) >> 1);
+        }
+        return solutions;
+    }
 };
 
+const int SolutionCounter::MAX_SIZE;
+const int SolutionCounter::MAX_SPLIT_ROWS;
+const int SolutionCounter::TASKS_PER_THREAD;
+
+// Formats the solution into a large buffer and hands it to stdio one chunk at a time,
+// which costs one write syscall per chunk instead of going through the stream per element.
+class SolutionWriter
+{
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+    static const size_t MAX_ENTRY_LENGTH = 16;
+    std::FILE* file;
+    std::vector<char> buffer;
+    size_t used = 0;
+public:
+    explicit SolutionWriter(std::FILE* file): file(file), buffer(BUFFER_SIZE) {}
+
+    ~SolutionWriter()
+    {
+        flush();
+    }
+
+    void writeText(const std::vector<int32_t>& solution)
+    {
+        append('[');
+        for (size_t i = 0; i < solution.size(); i++)
+        {
+            if (BUFFER_SIZE - used < MAX_ENTRY_LENGTH)
+            {
+                flush();
+            }
+            appendInt(solution[i]);
+            if (i != solution.size() - 1)
+            {
+                buffer[used++] = ',';
+                buffer[used++] = ' ';
+            }
+        }
+        append(']');
+        flush();
+    }
+
+    static bool writeBinary(const std::vector<int32_t>& solution, const std::string& path)
+    {
+        std::FILE* binaryFile = std::fopen(path.c_str(), "wb");
+        if (binaryFile == nullptr)
+        {
+            return false;
+        }
+        size_t written = std::fwrite(solution.data(), sizeof(int32_t), solution.size(), binaryFile);
+        return std::fclose(binaryFile) == 0 && written == solution.size();
+    }
+
+    void flush()
+    {
+        if (used > 0)
+        {
+            std::fwrite(buffer.data(), 1, used, file);
+            used = 0;
+        }
+        std::fflush(file);
+    }
+
+private:
+    void append(char symbol)
+    {
+        if (used == BUFFER_SIZE)
+        {
+            flush();
+        }
+        buffer[used++] = symbol;
+    }
+
+    void appendInt(int32_t value)
+    {
+        uint32_t magnitude = static_cast<uint32_t>(value);
+        if (value < 0)
+        {
+            buffer[used++] = '-';
+            magnitude = 0u - magnitude;
+        }
+        char digits[10];
+        int digitsCount = 0;
+        do
+        {
+            digits[digitsCount++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        while (digitsCount > 0)
+        {
+            buffer[used++] = digits[--digitsCount];
+        }
+    }
+};
+
+const size_t SolutionWriter::BUFFER_SIZE;
+const size_t SolutionWriter::MAX_ENTRY_LENGTH;
+
+int getThreadsCount()
+{
+    const char* env_p = std::getenv("FMI_THREADS");
+    if (env_p == nullptr)
+    {
+        return 1;
+    }
+    int threadsCount = std::stoi(env_p);
+    if (threadsCount <= 0)
+    {
+        threadsCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return threadsCount;
+}
+
+bool getIsCompact()
+{
+    const char* env_p = std::getenv("FMI_QUEENS_COMPACT");
+    return (env_p != nullptr && std::string(env_p) == "1");
+}
+
+unsigned int getSeed()
+{
+    const char* env_p = std::getenv("FMI_SEED");
+    return env_p != nullptr ? static_cast<unsigned int>(std::stoul(env_p)) : std::random_device()();
+}
+
+double getEnvDouble(const char* name, double defaultValue)
+{
+    const char* env_p = std::getenv(name);
+    return env_p != nullptr ? std::stod(env_p) : defaultValue;
+}
+
+SolverSettings getSolverSettings(bool shouldPrint)
+{
+    SolverSettings settings;
+    settings.mode = getSolverMode();
+    const char* escape_p = std::getenv("FMI_QUEENS_ESCAPE");
+    if (escape_p != nullptr)
+    {
+        settings.escape = escapeFromString(escape_p);
+    }
+    // The swap, count and construct modes have no escape step
+    if (settings.mode != SolverMode::MIN_CONFLICTS && settings.escape != EscapeStrategy::RESTART)
+    {
+        throw std::invalid_argument("FMI_QUEENS_ESCAPE only applies to the min-conflicts mode");
+    }
+    settings.initialTemperature = getEnvDouble("FMI_QUEENS_TEMPERATURE", settings.initialTemperature);
+    settings.minTemperature = getEnvDouble("FMI_QUEENS_MIN_TEMPERATURE", settings.minTemperature);
+    settings.coolingRate = getEnvDouble("FMI_QUEENS_COOLING", settings.coolingRate);
+    settings.tabuTenure = static_cast<int>(getEnvDouble("FMI_QUEENS_TABU_TENURE", settings.tabuTenure));
+    settings.maxIterationsMult = static_cast<long long>(getEnvDouble("FMI_QUEENS_MAX_ITERATIONS_MULT",
+                                                                     static_cast<double>(settings.maxIterationsMult)));
+    settings.restartMult = static_cast<int>(getEnvDouble("FMI_QUEENS_RESTART_MULT", settings.restartMult));
+    const char* telemetry_p = std::getenv("FMI_QUEENS_STATS");
+    settings.collectTelemetry = telemetry_p != nullptr && std::string(telemetry_p) == "1";
+    settings.isCompact = getIsCompact();
+    settings.threadsCount = getThreadsCount();
+    settings.seed = getSeed();
+    settings.shouldPrint = shouldPrint;
+    return settings;
+}
+
+bool getIsFixedInput()
+{
+    const char* env_p = std::getenv("FMI_QUEENS_FIXED");
+    return (env_p != nullptr && std::string(env_p) == "1");
+}
+
+// Input after n with FMI_QUEENS_FIXED=1: the count of pinned queens followed by a "column row" pair for each of them
+std::vector<std::pair<int, int>> readFixedQueens(int n)
+{
+    int fixedCount = 0;
+    if (!(std::cin >> fixedCount) || fixedCount < 0 || fixedCount > n)
+    {
+        throw std::invalid_argument("The count of fixed queens must be between 0 and n");
+    }
+    std::vector<std::pair<int, int>> fixedQueens(fixedCount);
+    for (auto& queen : fixedQueens)
+    {
+        if (!(std::cin >> queen.first >> queen.second))
+        {
+            throw std::invalid_argument("Truncated list of fixed queens");
+        }
+    }
+    return fixedQueens;
+}
+
+bool getIsVerify()
+{
+    const char* env_p = std::getenv("FMI_QUEENS_VERIFY");
+    return (env_p != nullptr && std::string(env_p) == "1");
+}
+
 bool getIsTimeOnly()
 {
     const char* env_p = std::getenv("FMI_TIME_ONLY");
@@ -268,34 +1362,95 @@ bool getIsTimeOnly()
 
 int main()
 {
-    srand(time(nullptr));
     int n = 0;
     std::cin >> n;
     bool shouldPrint = false;
     bool isTimeOnly = getIsTimeOnly();
+    SolverSettings settings = getSolverSettings(shouldPrint);
+    int threadsCount = settings.threadsCount;
+    if (settings.mode == SolverMode::COUNT)
+    {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        unsigned long long solutionsCount = SolutionCounter::count(n, threadsCount);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+        std::cout << "# TIMES_MS: alg=" << elapsed << std::endl;
+        if (!isTimeOnly)
+        {
+            std::cout << solutionsCount;
+        }
+        return 0;
+    }
     if (n == 2 || n == 3)
     {
         std::cout << -1;
         return 0;
     }
 
+    FixedPlacement placement(n, getIsFixedInput() ? readFixedQueens(n) : std::vector<std::pair<int, int>>());
+    if (settings.mode == SolverMode::CONSTRUCT && !placement.getQueens().empty())
+    {
+        throw std::invalid_argument("The explicit construction cannot honour pinned queens");
+    }
+
     std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-    std::vector<int> solution = Solver::solve(*(new Board(n)), shouldPrint);
+    std::vector<SearchStats> stats;
+    std::vector<int> solution = settings.mode == SolverMode::CONSTRUCT
+            ? ExplicitConstruction::place(n)
+            : Solver::solveParallel(n, placement, settings, stats);
     std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
     std::cout << "# TIMES_MS: alg=" << elapsed << std::endl;
+    if (getIsVerify())
+    {
+        std::chrono::steady_clock::time_point verifyBegin = std::chrono::steady_clock::now();
+        bool isValid = SolutionVerifier::isValid(n, solution, placement);
+        std::chrono::steady_clock::time_point verifyEnd = std::chrono::steady_clock::now();
+        std::cout << "# VERIFY: valid=" << isValid << " ms="
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(verifyEnd - verifyBegin).count() << std::endl;
+        if (!isValid)
+        {
+            return 1;
+        }
+    }
+    if (settings.mode != SolverMode::CONSTRUCT && (threadsCount > 1 || settings.collectTelemetry))
+    {
+        for (int worker = 0; worker < threadsCount; worker++)
+        {
+            std::cout << "# WORKER_STATS: worker=" << worker
+                      << " restarts=" << stats[worker].restarts
+                      << " iterations=" << stats[worker].iterations
+                      << " solved=" << stats[worker].solved;
+            if (settings.collectTelemetry)
+            {
+                std::cout << " column_selection_ms=" << stats[worker].columnSelectionNs / 1000000
+                          << " row_selection_ms=" << stats[worker].rowSelectionNs / 1000000
+                          << " first_zero_ms=" << stats[worker].firstZeroMs;
+            }
+            std::cout << std::endl;
+            if (settings.collectTelemetry)
+            {
+                std::cout << "# COLLISIONS_TRACE: worker=" << worker << " samples=";
+                const auto& samples = stats[worker].collisionSamples;
+                for (size_t i = 0; i < samples.size(); i++)
+                {
+                    std::cout << (i == 0 ? "" : ",") << samples[i].first << ":" << samples[i].second;
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
     if (isTimeOnly)
     {
         return 0;
     }
-    std::cout<<"[";
-    for (int i = 0; i < solution.size(); i++)
+    const char* binaryPath = std::getenv("FMI_QUEENS_BINARY_OUT");
+    if (binaryPath != nullptr && !SolutionWriter::writeBinary(solution, binaryPath))
     {
-        std::cout << solution[i];
-        if (i != solution.size() - 1)
-            std::cout << ", ";
+        std::cerr << "Could not write " << binaryPath << std::endl;
     }
-    std::cout<<"]";
+    std::cout.flush();
+    SolutionWriter(stdout).writeText(solution);
 
     return 0;
 }
\ No newline at end of file
@@ -6,6 +6,33 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <iomanip>
+#include <cmath>
+#include <queue>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <limits>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+#include <fstream>
+#include <bitset>
+#include <sstream>
+#include <cstdio>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 bool getIsTimeOnly()
 {
@@ -13,11 +40,291 @@ bool getIsTimeOnly()
     return (env_p != nullptr && std::string(env_p) == "1");
 }
 
+bool getIsMatrixFree()
+{
+    const char* env_p = std::getenv("FMI_TSP_MATRIX_FREE");
+    return (env_p != nullptr && std::string(env_p) == "1");
+}
+
+// Computes the optimum with Held-Karp and traces the gap of the chosen solver to it
+bool getIsGapBenchmark()
+{
+    const char* env_p = std::getenv("FMI_TSP_GAP");
+    return (env_p != nullptr && std::string(env_p) == "1");
+}
+
+// Path of a TSPLIB or plain coordinate file to read instead of the standard input
+std::string getInputFile()
+{
+    const char* env_p = std::getenv("FMI_TSP_FILE");
+    return env_p != nullptr ? env_p : "";
+}
+
+int getNeighborsCount()
+{
+    const char* env_p = std::getenv("FMI_TSP_NEIGHBORS");
+    return env_p != nullptr ? std::stoi(env_p) : 10;
+}
+
 double calculateDistance(double x1, double y1, double x2, double y2)
 {
     return std::sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
 }
 
+// Coordinates are kept as structure of arrays. Small instances also get the full distance matrix,
+// large ones compute distances on demand and only store k nearest candidate neighbours per city.
+class TSPInstance
+{
+private:
+    static const int MATRIX_MAX_SIZE = 4000;
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::vector<std::vector<double>> distanceMatrix;
+    int neighborsCount = 0;
+    std::vector<int> neighbors;
+public:
+    TSPInstance(const std::vector<std::pair<double, double>>& points, bool forceMatrixFree, int maxNeighborsCount)
+        : xs(points.size()), ys(points.size())
+    {
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            xs[i] = points[i].first;
+            ys[i] = points[i].second;
+        }
+        if (!forceMatrixFree && getSize() <= MATRIX_MAX_SIZE)
+        {
+            distanceMatrix = getDistanceMatrix();
+        }
+        neighborsCount = std::max(0, std::min(maxNeighborsCount, getSize() - 1));
+        buildNeighbors();
+    }
+
+    int getSize() const
+    {
+        return xs.size();
+    }
+
+    bool isMatrixFree() const
+    {
+        return distanceMatrix.empty();
+    }
+
+    double getDistance(int from, int to) const
+    {
+        if (!distanceMatrix.empty())
+        {
+            return distanceMatrix[from][to];
+        }
+        return calculateDistance(xs[from], ys[from], xs[to], ys[to]);
+    }
+
+    double getX(int city) const
+    {
+        return xs[city];
+    }
+
+    double getY(int city) const
+    {
+        return ys[city];
+    }
+
+    int getNeighborsCount() const
+    {
+        return neighborsCount;
+    }
+
+    // The candidate neighbours of the city, closest first
+    const int* getNeighbors(int city) const
+    {
+        return neighbors.data() + (size_t)city * neighborsCount;
+    }
+
+    // FNV-1a hash of the coordinates, telling checkpoints of this instance from other ones
+    unsigned long long getFingerprint() const
+    {
+        unsigned long long hash = 14695981039346656037ull;
+        for (const std::vector<double>* coordinates : {&xs, &ys})
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(coordinates->data());
+            for (size_t k = 0; k < coordinates->size() * sizeof(double); k++)
+            {
+                hash = (hash ^ bytes[k]) * 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+
+    // With AVX2 the edges are evaluated four at a time from coordinates loaded by gathers
+    double getPathWeight(const int* nodes) const
+    {
+        int edgesCount = getSize() - 1;
+        int j = 0;
+        double totalWeight = 0.0;
+#ifdef __AVX2__
+        __m256d sums = _mm256_setzero_pd();
+        for (; j + 4 <= edgesCount; j += 4)
+        {
+            __m128i from = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nodes + j));
+            __m128i to = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nodes + j + 1));
+            sums = _mm256_add_pd(sums, getDistances(from, to));
+        }
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, sums);
+        totalWeight = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+        for (; j < edgesCount; j++)
+        {
+            totalWeight += getDistance(nodes[j], nodes[j + 1]);
+        }
+        return totalWeight;
+    }
+
+    // Weights of a batch of paths, each evaluated along the path. Giving every AVX2 lane its own
+    // path instead needs four scalar index loads per step and measured slower.
+    void getPathWeights(const int* const* paths, int pathsCount, double* weights) const
+    {
+        for (int p = 0; p < pathsCount; p++)
+        {
+            weights[p] = getPathWeight(paths[p]);
+        }
+    }
+
+private:
+#ifdef __AVX2__
+    __m256d getDistances(__m128i from, __m128i to) const
+    {
+        // The masked gathers with a zero source avoid reading an undefined register
+        __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        __m256d zero = _mm256_setzero_pd();
+        __m256d dx = _mm256_sub_pd(_mm256_mask_i32gather_pd(zero, xs.data(), from, all, 8),
+                                   _mm256_mask_i32gather_pd(zero, xs.data(), to, all, 8));
+        __m256d dy = _mm256_sub_pd(_mm256_mask_i32gather_pd(zero, ys.data(), from, all, 8),
+                                   _mm256_mask_i32gather_pd(zero, ys.data(), to, all, 8));
+        return _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+    }
+#endif
+
+    std::vector<std::vector<double>> getDistanceMatrix() const
+    {
+        int n = getSize();
+        std::vector<std::vector<double>> matrix(n, std::vector<double>(n, 0.0));
+        for (int i = 0; i < n; i++)
+        {
+            for (int j = i + 1; j < n; j++)
+            {
+                double dist = calculateDistance(xs[i], ys[i], xs[j], ys[j]);
+                matrix[i][j] = dist;
+                matrix[j][i] = dist;
+            }
+        }
+        return matrix;
+    }
+
+    // Buckets the cities into a uniform grid of about two cities per cell and searches rings of cells
+    // around each city until no unvisited cell can hold anything closer than the current k-th neighbour.
+    void buildNeighbors()
+    {
+        int n = getSize();
+        neighbors.assign((size_t)n * neighborsCount, -1);
+        if (neighborsCount == 0)
+        {
+            return;
+        }
+
+        double minX = *std::min_element(xs.begin(), xs.end());
+        double maxX = *std::max_element(xs.begin(), xs.end());
+        double minY = *std::min_element(ys.begin(), ys.end());
+        double maxY = *std::max_element(ys.begin(), ys.end());
+        int cellsPerSide = std::max(1, (int)std::sqrt(n / 2.0));
+        double cellSize = std::max(maxX - minX, maxY - minY) / cellsPerSide;
+        if (cellSize <= 0.0)
+        {
+            cellSize = 1.0;
+        }
+        auto getCell = [&](double coordinate, double minCoordinate)
+        {
+            return std::min(cellsPerSide - 1, (int)((coordinate - minCoordinate) / cellSize));
+        };
+
+        std::vector<int> cellStart(cellsPerSide * cellsPerSide + 1, 0);
+        std::vector<int> cityCells(n);
+        for (int city = 0; city < n; city++)
+        {
+            cityCells[city] = getCell(ys[city], minY) * cellsPerSide + getCell(xs[city], minX);
+            cellStart[cityCells[city] + 1]++;
+        }
+        for (size_t cell = 1; cell < cellStart.size(); cell++)
+        {
+            cellStart[cell] += cellStart[cell - 1];
+        }
+        std::vector<int> cellCities(n);
+        std::vector<int> cellFill(cellStart.begin(), cellStart.end() - 1);
+        for (int city = 0; city < n; city++)
+        {
+            cellCities[cellFill[cityCells[city]]++] = city;
+        }
+
+        std::priority_queue<std::pair<double, int>> closest;
+        for (int city = 0; city < n; city++)
+        {
+            int cellX = cityCells[city] % cellsPerSide;
+            int cellY = cityCells[city] / cellsPerSide;
+            for (int ring = 0; ring < cellsPerSide; ring++)
+            {
+                for (int y = cellY - ring; y <= cellY + ring; y++)
+                {
+                    if (y < 0 || y >= cellsPerSide)
+                    {
+                        continue;
+                    }
+                    bool isEdgeRow = (y == cellY - ring || y == cellY + ring);
+                    for (int x = cellX - ring; x <= cellX + ring; x += (isEdgeRow || ring == 0) ? 1 : 2 * ring)
+                    {
+                        if (x < 0 || x >= cellsPerSide)
+                        {
+                            continue;
+                        }
+                        int cell = y * cellsPerSide + x;
+                        for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++)
+                        {
+                            int other = cellCities[k];
+                            if (other == city)
+                            {
+                                continue;
+                            }
+                            double dx = xs[city] - xs[other];
+                            double dy = ys[city] - ys[other];
+                            double squaredDistance = dx * dx + dy * dy;
+                            if ((int)closest.size() < neighborsCount)
+                            {
+                                closest.emplace(squaredDistance, other);
+                            }
+                            else if (squaredDistance < closest.top().first)
+                            {
+                                closest.pop();
+                                closest.emplace(squaredDistance, other);
+                            }
+                        }
+                    }
+                }
+                double reach = ring * cellSize;
+                if ((int)closest.size() == neighborsCount && closest.top().first <= reach * reach)
+                {
+                    break;
+                }
+            }
+            int* cityNeighbors = neighbors.data() + (size_t)city * neighborsCount;
+            for (int k = neighborsCount - 1; k >= 0; k--)
+            {
+                cityNeighbors[k] = closest.top().second;
+                closest.pop();
+            }
+        }
+    }
+};
+
+const int TSPInstance::MATRIX_MAX_SIZE;
+
 struct Path
 {
     std::vector<int> nodes;
@@ -35,246 +342,2781 @@ struct Path
     }
 };
 
-class TSPGeneticSolver
+// Time limit shared by the threads of one search. Long loops poll it, so a single generation or
+// local search pass stops at the limit instead of overrunning it. Once passed it stays passed.
+class Deadline
 {
 private:
-    std::vector<std::pair<double, double>> points;
-    std::vector<std::vector<double>> distanceMatrix;
-    std::vector<Path> population;
-    std::mt19937 rng{std::random_device{}()};
-    int populationSize = 100;
-    static const int POPULATION_KEEP = 2;
-    static const int POPULATION_KEEP_RESTART_PERCENTAGE = 2;
-    static const int MAX_GENERATIONS = 10000;
-    static const int STAGNATION_COEF = 2;
-    static const int GENERATIONS_TO_PRINT = 10;
-    static const int MUTATION_PERCENTAGE = 5;
+    std::chrono::steady_clock::time_point endTime;
+    bool isTimed;
+    std::atomic<bool> isPassed{false};
 public:
-    explicit TSPGeneticSolver(const std::vector<std::pair<double, double>>& points)
-        : points(points)
+    Deadline(std::chrono::steady_clock::time_point startTime, long long timeLimitMs)
+        : endTime(startTime + std::chrono::milliseconds(timeLimitMs)), isTimed(timeLimitMs > 0)
     {
-        distanceMatrix = getDistanceMatrix(points);
-        addRandomPopulation(populationSize);
     }
 
-    Path findBestPath(bool shouldPrint = false)
+    bool hasPassed()
+    {
+        if (isPassed.load(std::memory_order_relaxed))
+        {
+            return true;
+        }
+        if (isTimed && std::chrono::steady_clock::now() >= endTime)
+        {
+            isPassed.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void stop()
+    {
+        isPassed.store(true, std::memory_order_relaxed);
+    }
+};
+
+// 2-opt and Or-opt improvement driven by the candidate lists and don't-look bits.
+// The open path is closed into a cycle through a virtual depot at distance 0 from every city,
+// so both path ends are ordinary cycle edges. The cycle is an array with a position index and
+// every move is a sequence of 2-opt moves, each reversing the shorter side of the cycle.
+class LocalSearch
+{
+private:
+    static const int MIN_SIZE = 8;
+    static const int MAX_SEGMENT_LENGTH = 3;
+    static const int MAX_KICK_SEGMENT_LENGTH = 50;
+    static const int DEADLINE_CHECK_INTERVAL = 256;
+    static constexpr double EPSILON = 1e-10;
+    const TSPInstance& instance;
+    int depot;
+    int cycleSize;
+    std::vector<int> order;
+    std::vector<int> position;
+    std::vector<char> isActive;
+    std::deque<int> activeQueue;
+    // The 2-opt moves since the last load or commit, as (a, b, c, d) quadruples
+    std::vector<int> journal;
+public:
+    explicit LocalSearch(const TSPInstance& instance)
+        : instance(instance), depot(instance.getSize()), cycleSize(instance.getSize() + 1),
+          order(cycleSize), position(cycleSize), isActive(cycleSize, 0)
+    {
+    }
+
+    bool isApplicable() const
+    {
+        return cycleSize >= MIN_SIZE;
+    }
+
+    // Improves the path in place and returns the total gain
+    double improve(int* nodes, Deadline* deadline = nullptr)
+    {
+        if (!isApplicable())
+        {
+            return 0.0;
+        }
+        load(nodes);
+        double totalGain = optimize(deadline);
+        store(nodes);
+        return totalGain;
+    }
+
+    // Makes the path the current cycle, with every city to be examined
+    void load(const int* nodes)
+    {
+        order[0] = depot;
+        std::copy(nodes, nodes + cycleSize - 1, order.begin() + 1);
+        for (int i = 0; i < cycleSize; i++)
+        {
+            position[order[i]] = i;
+        }
+        activeQueue.clear();
+        std::fill(isActive.begin(), isActive.end(), 0);
+        for (int i = 0; i < cycleSize; i++)
+        {
+            activate(order[i]);
+        }
+        journal.clear();
+    }
+
+    void store(int* nodes) const
+    {
+        int start = position[depot];
+        for (int k = 0; k < cycleSize - 1; k++)
+        {
+            int index = start + 1 + k;
+            nodes[k] = order[index >= cycleSize ? index - cycleSize : index];
+        }
+    }
+
+    // Double bridge inside a window after a random city: a B C d becomes a C B d.
+    // Returns the change of the weight, only the ends of the moved segments are examined afterwards.
+    double kick(std::mt19937& rng)
+    {
+        int maxLength = std::min(MAX_KICK_SEGMENT_LENGTH, (cycleSize - 2) / 2);
+        std::uniform_int_distribution<int> lengthDistribution(1, maxLength);
+        int start = std::uniform_int_distribution<int>(0, cycleSize - 1)(rng);
+        int lengthB = lengthDistribution(rng);
+        int lengthC = lengthDistribution(rng);
+        auto at = [&](int offset) { return order[(start + offset) % cycleSize]; };
+        int a = at(0);
+        int firstB = at(1);
+        int lastB = at(lengthB);
+        int firstC = at(lengthB + 1);
+        int lastC = at(lengthB + lengthC);
+        int d = at(lengthB + lengthC + 1);
+
+        // a [B] [C] d  ->  a [C'] [B'] d  ->  a [C] [B'] d  ->  a [C] [B] d
+        makeTwoOptMove(a, firstB, lastC, d);
+        makeTwoOptMove(a, lastC, firstC, lastB);
+        makeTwoOptMove(lastC, lastB, firstB, d);
+        for (int city : {a, firstB, lastB, firstC, lastC, d})
+        {
+            activate(city);
+        }
+        return getDistance(a, firstC) + getDistance(lastC, firstB) + getDistance(lastB, d)
+               - getDistance(a, firstB) - getDistance(lastB, firstC) - getDistance(lastC, d);
+    }
+
+    void commit()
+    {
+        journal.clear();
+    }
+
+    // Undoes every move since the last load or commit
+    void revert()
+    {
+        for (size_t k = journal.size(); k > 0; k -= 4)
+        {
+            int a = journal[k - 4];
+            int b = journal[k - 3];
+            int c = journal[k - 2];
+            int d = journal[k - 1];
+            applyTwoOptMove(a, c, b, d);
+        }
+        journal.clear();
+        for (int city : activeQueue)
+        {
+            isActive[city] = 0;
+        }
+        activeQueue.clear();
+    }
+
+    // Applies improving moves until no active city is left or the deadline has passed
+    // and returns the total gain. An interrupted cycle is valid, just not locally optimal.
+    double optimize(Deadline* deadline = nullptr)
+    {
+        double totalGain = 0.0;
+        for (long long pops = 0; !activeQueue.empty(); pops++)
+        {
+            if (deadline && pops % DEADLINE_CHECK_INTERVAL == 0 && deadline->hasPassed())
+            {
+                break;
+            }
+            int city = activeQueue.front();
+            activeQueue.pop_front();
+            isActive[city] = 0;
+            double gain = tryTwoOpt(city, true);
+            if (gain <= 0.0) gain = tryTwoOpt(city, false);
+            if (gain <= 0.0) gain = tryOrOpt(city, true);
+            if (gain <= 0.0) gain = tryOrOpt(city, false);
+            if (gain > 0.0)
+            {
+                totalGain += gain;
+                activate(city);
+            }
+        }
+        return totalGain;
+    }
+
+private:
+    double getDistance(int from, int to) const
+    {
+        if (from == depot || to == depot)
+        {
+            return 0.0;
+        }
+        return instance.getDistance(from, to);
+    }
+
+    int getNext(int city, bool isForward) const
+    {
+        int index = position[city] + (isForward ? 1 : -1);
+        if (index == cycleSize) index = 0;
+        if (index < 0) index = cycleSize - 1;
+        return order[index];
+    }
+
+    void activate(int city)
+    {
+        if (!isActive[city])
+        {
+            isActive[city] = 1;
+            activeQueue.push_back(city);
+        }
+    }
+
+    // The depot is a candidate of every city, which lets any city become a path end
+    template <typename Visitor>
+    void forEachCandidate(int city, Visitor visit) const
+    {
+        if (city != depot)
+        {
+            if (!visit(depot))
+            {
+                return;
+            }
+            const int* neighbors = instance.getNeighbors(city);
+            for (int k = 0; k < instance.getNeighborsCount(); k++)
+            {
+                if (!visit(neighbors[k]))
+                {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Reverses the cycle from city "from" forward to city "to", or the complementary
+    // part if that is shorter. Both give the same cycle, only the orientation differs.
+    void reverse(int from, int to)
+    {
+        int i = position[from];
+        int j = position[to];
+        int length = (j - i + cycleSize) % cycleSize + 1;
+        if (2 * length > cycleSize)
+        {
+            std::swap(i, j);
+            i = (i + 1) % cycleSize;
+            j = (j - 1 + cycleSize) % cycleSize;
+            length = cycleSize - length;
+        }
+        for (int step = 0; step < length / 2; step++)
+        {
+            int first = order[i];
+            int second = order[j];
+            order[i] = second;
+            position[second] = i;
+            order[j] = first;
+            position[first] = j;
+            if (++i == cycleSize) i = 0;
+            if (--j < 0) j = cycleSize - 1;
+        }
+    }
+
+    // Replaces the edges (a, b) and (c, d) with (a, c) and (b, d). Both edges must point
+    // the same way, b and d following a and c in either the forward or the backward direction.
+    void makeTwoOptMove(int a, int b, int c, int d)
+    {
+        journal.insert(journal.end(), {a, b, c, d});
+        applyTwoOptMove(a, b, c, d);
+    }
+
+    void applyTwoOptMove(int a, int b, int c, int d)
+    {
+        if (getNext(a, true) == b)
+        {
+            reverse(b, c);
+        }
+        else
+        {
+            reverse(a, d);
+        }
+    }
+
+    double tryTwoOpt(int a, bool isForward)
+    {
+        int b = getNext(a, isForward);
+        double removedAB = getDistance(a, b);
+        double bestGain = EPSILON;
+        int bestC = -1;
+        forEachCandidate(a, [&](int c)
+        {
+            double partialGain = removedAB - getDistance(a, c);
+            if (partialGain <= 0.0)
+            {
+                return false;
+            }
+            int d = getNext(c, isForward);
+            if (c != b && d != a)
+            {
+                double gain = partialGain + getDistance(c, d) - getDistance(b, d);
+                if (gain > bestGain)
+                {
+                    bestGain = gain;
+                    bestC = c;
+                }
+            }
+            return true;
+        });
+        if (bestC < 0)
+        {
+            return 0.0;
+        }
+        int d = getNext(bestC, isForward);
+        makeTwoOptMove(a, b, bestC, d);
+        activate(a);
+        activate(b);
+        activate(bestC);
+        activate(d);
+        return bestGain;
+    }
+
+    // Moves the segment of up to MAX_SEGMENT_LENGTH cities starting at s1 next to one of s1's candidates,
+    // either between c and its successor (s1 next to c) or between c's predecessor and c (reversed).
+    double tryOrOpt(int s1, bool isForward)
+    {
+        int segment[MAX_SEGMENT_LENGTH];
+        int s2 = s1;
+        for (int length = 1; length <= MAX_SEGMENT_LENGTH; length++)
+        {
+            if (length > 1)
+            {
+                s2 = getNext(s2, isForward);
+            }
+            segment[length - 1] = s2;
+            int p = getNext(s1, !isForward);
+            int next = getNext(s2, isForward);
+            if (p == s2 || next == s1 || p == next)
+            {
+                return 0.0;
+            }
+            double removeGain = getDistance(p, s1) + getDistance(s2, next) - getDistance(p, next);
+            if (removeGain <= EPSILON)
+            {
+                continue;
+            }
+            auto isInSegment = [&](int city)
+            {
+                return std::find(segment, segment + length, city) != segment + length;
+            };
+
+            double bestGain = EPSILON;
+            int bestC = -1;
+            int bestD = -1;
+            bool bestIsReversed = false;
+            forEachCandidate(s1, [&](int c)
+            {
+                if (getDistance(s1, c) >= removeGain)
+                {
+                    return false;
+                }
+                if (isInSegment(c))
+                {
+                    return true;
+                }
+                int d = getNext(c, isForward);
+                if (!isInSegment(d) && c != next && d != p)
+                {
+                    double gain = removeGain - (getDistance(c, s1) + getDistance(s2, d) - getDistance(c, d));
+                    if (gain > bestGain)
+                    {
+                        bestGain = gain;
+                        bestC = c;
+                        bestD = d;
+                        bestIsReversed = false;
+                    }
+                }
+                int e = getNext(c, !isForward);
+                if (!isInSegment(e) && e != next && c != p)
+                {
+                    double gain = removeGain - (getDistance(e, s2) + getDistance(s1, c) - getDistance(e, c));
+                    if (gain > bestGain)
+                    {
+                        bestGain = gain;
+                        bestC = e;
+                        bestD = c;
+                        bestIsReversed = true;
+                    }
+                }
+                return true;
+            });
+            if (bestC < 0)
+            {
+                continue;
+            }
+
+            // p [s1..s2] next ... c d  ->  p next ... c [s2..s1] d
+            makeTwoOptMove(p, s1, bestC, bestD);
+            makeTwoOptMove(p, bestC, next, s2);
+            if (!bestIsReversed)
+            {
+                // -> p next ... c [s1..s2] d
+                makeTwoOptMove(bestC, s2, s1, bestD);
+            }
+            activate(p);
+            activate(next);
+            activate(bestC);
+            activate(bestD);
+            activate(s2);
+            return bestGain;
+        }
+        return 0.0;
+    }
+};
+
+const int LocalSearch::MIN_SIZE;
+const int LocalSearch::MAX_SEGMENT_LENGTH;
+const int LocalSearch::MAX_KICK_SEGMENT_LENGTH;
+const int LocalSearch::DEADLINE_CHECK_INTERVAL;
+constexpr double LocalSearch::EPSILON;
+
+// Edge assembly crossover on the parents closed into cycles through the virtual depot, as in the
+// local search. The edges in which the parents differ split into AB-cycles alternating between
+// the two parents. The child is the first parent with the edges of one random AB-cycle exchanged
+// for those of the second, and the subtours this leaves are merged by the cheapest exchange of
+// two edges found through the candidate lists.
+class EdgeAssemblyCrossover
+{
+private:
+    const TSPInstance& instance;
+    int depot;
+    int cycleSize;
+    // Two links per node, the cycle neighbours of the node
+    std::vector<int> linksA;
+    std::vector<int> linksB;
+    std::vector<int> childLinks;
+    // Links of the parents that are not shared, -1 once used by an AB-cycle
+    std::vector<int> remainingA;
+    std::vector<int> remainingB;
+    // Walk index of every node for even and odd positions in the walk, -1 if absent
+    std::vector<int> walk;
+    std::vector<int> walkIndex;
+    // Every AB-cycle starts with an edge of A, then alternates
+    std::vector<int> cycleNodes;
+    std::vector<int> cycleStarts;
+    std::vector<int> component;
+    std::vector<int> componentSizes;
+    std::vector<int> componentStarts;
+    std::vector<int> members;
+public:
+    explicit EdgeAssemblyCrossover(const TSPInstance& instance)
+        : instance(instance), depot(instance.getSize()), cycleSize(instance.getSize() + 1),
+          linksA(2 * cycleSize), linksB(2 * cycleSize), childLinks(2 * cycleSize),
+          remainingA(2 * cycleSize), remainingB(2 * cycleSize), walkIndex(2 * cycleSize, -1),
+          component(cycleSize)
+    {
+    }
+
+    void cross(const int* parent1, const int* parent2, int* child, std::mt19937& rng)
+    {
+        setLinks(linksA, parent1);
+        setLinks(linksB, parent2);
+        childLinks = linksA;
+        findCycles(rng);
+        if (!cycleStarts.empty())
+        {
+            int cycle = std::uniform_int_distribution<int>(0, cycleStarts.size() - 1)(rng);
+            applyCycle(cycle);
+            mergeSubtours();
+        }
+
+        int previous = depot;
+        int current = childLinks[2 * depot];
+        for (int k = 0; k < cycleSize - 1; k++)
+        {
+            child[k] = current;
+            int next = getOtherLink(current, previous);
+            previous = current;
+            current = next;
+        }
+    }
+
+private:
+    double getDistance(int from, int to) const
+    {
+        if (from == depot || to == depot)
+        {
+            return 0.0;
+        }
+        return instance.getDistance(from, to);
+    }
+
+    void setLinks(std::vector<int>& links, const int* nodes) const
+    {
+        int last = cycleSize - 2;
+        links[2 * depot] = nodes[0];
+        links[2 * depot + 1] = nodes[last];
+        for (int k = 0; k <= last; k++)
+        {
+            links[2 * nodes[k]] = k > 0 ? nodes[k - 1] : depot;
+            links[2 * nodes[k] + 1] = k < last ? nodes[k + 1] : depot;
+        }
+    }
+
+    static bool hasLink(const std::vector<int>& links, int node, int other)
+    {
+        return links[2 * node] == other || links[2 * node + 1] == other;
+    }
+
+    static void replaceLink(std::vector<int>& links, int node, int oldOther, int newOther)
+    {
+        links[2 * node + (links[2 * node] == oldOther ? 0 : 1)] = newOther;
+    }
+
+    int getOtherLink(int node, int other) const
+    {
+        return childLinks[2 * node] == other ? childLinks[2 * node + 1] : childLinks[2 * node];
+    }
+
+    // Takes a random unused link of the node out of both of its ends, -1 if there is none
+    static int takeRemaining(std::vector<int>& remaining, int node, std::mt19937& rng)
+    {
+        int first = remaining[2 * node];
+        int second = remaining[2 * node + 1];
+        int slot;
+        if (first == -1 && second == -1)
+        {
+            return -1;
+        }
+        else if (first == -1 || second == -1)
+        {
+            slot = first == -1 ? 1 : 0;
+        }
+        else
+        {
+            slot = rng() & 1;
+        }
+        int other = remaining[2 * node + slot];
+        remaining[2 * node + slot] = -1;
+        remaining[2 * other + (remaining[2 * other] == node ? 0 : 1)] = -1;
+        return other;
+    }
+
+    // Walks alternately along unused edges of A and B. Whenever the walk returns to a node at a
+    // position of the same parity, the part of the walk in between closes an AB-cycle.
+    void findCycles(std::mt19937& rng)
+    {
+        for (int node = 0; node < cycleSize; node++)
+        {
+            for (int slot = 0; slot < 2; slot++)
+            {
+                int otherA = linksA[2 * node + slot];
+                int otherB = linksB[2 * node + slot];
+                remainingA[2 * node + slot] = hasLink(linksB, node, otherA) ? -1 : otherA;
+                remainingB[2 * node + slot] = hasLink(linksA, node, otherB) ? -1 : otherB;
+            }
+        }
+        cycleNodes.clear();
+        cycleStarts.clear();
+
+        int offset = std::uniform_int_distribution<int>(0, cycleSize - 1)(rng);
+        for (int i = 0; i < cycleSize; i++)
+        {
+            int start = (offset + i) % cycleSize;
+            walk.clear();
+            walk.push_back(start);
+            walkIndex[2 * start] = 0;
+            while (walk.size() > 1 || remainingA[2 * start] != -1 || remainingA[2 * start + 1] != -1)
+            {
+                int index = walk.size() - 1;
+                int next = takeRemaining(index % 2 == 0 ? remainingA : remainingB, walk.back(), rng);
+                if (next == -1)
+                {
+                    break;
+                }
+                int position = index + 1;
+                walk.push_back(next);
+                int& closingIndex = walkIndex[2 * next + position % 2];
+                if (closingIndex == -1)
+                {
+                    closingIndex = position;
+                    continue;
+                }
+
+                int first = closingIndex;
+                cycleStarts.push_back(cycleNodes.size());
+                if (first % 2 == 0)
+                {
+                    cycleNodes.insert(cycleNodes.end(), walk.begin() + first, walk.end() - 1);
+                }
+                else
+                {
+                    cycleNodes.insert(cycleNodes.end(), walk.begin() + first + 1, walk.end());
+                }
+                for (int k = first + 1; k < position; k++)
+                {
+                    walkIndex[2 * walk[k] + k % 2] = -1;
+                }
+                walk.resize(first + 1);
+            }
+            for (int k = 0; k < static_cast<int>(walk.size()); k++)
+            {
+                walkIndex[2 * walk[k] + k % 2] = -1;
+            }
+        }
+    }
+
+    // Removes the edges of A in the cycle from the child and adds the edges of B
+    void applyCycle(int cycle)
+    {
+        int begin = cycleStarts[cycle];
+        int end = cycle + 1 < static_cast<int>(cycleStarts.size()) ? cycleStarts[cycle + 1] : cycleNodes.size();
+        int length = end - begin;
+        for (int k = 0; k < length; k++)
+        {
+            int node = cycleNodes[begin + k];
+            int previous = cycleNodes[begin + (k + length - 1) % length];
+            int next = cycleNodes[begin + (k + 1) % length];
+            if (k % 2 == 0)
+            {
+                replaceLink(childLinks, node, next, previous);
+            }
+            else
+            {
+                replaceLink(childLinks, node, previous, next);
+            }
+        }
+    }
+
+    void collectMembers(int start)
+    {
+        members.clear();
+        int previous = childLinks[2 * start + 1];
+        int current = start;
+        do
+        {
+            members.push_back(current);
+            int next = getOtherLink(current, previous);
+            previous = current;
+            current = next;
+        }
+        while (current != start);
+    }
+
+    // Merges the smallest subtour into another one until a single tour remains
+    void mergeSubtours()
+    {
+        std::fill(component.begin(), component.end(), -1);
+        componentSizes.clear();
+        componentStarts.clear();
+        for (int node = 0; node < cycleSize; node++)
+        {
+            if (component[node] != -1)
+            {
+                continue;
+            }
+            collectMembers(node);
+            for (int member : members)
+            {
+                component[member] = componentSizes.size();
+            }
+            componentSizes.push_back(members.size());
+            componentStarts.push_back(node);
+        }
+
+        for (int merges = componentSizes.size() - 1; merges > 0; merges--)
+        {
+            int smallest = -1;
+            for (int id = 0; id < static_cast<int>(componentSizes.size()); id++)
+            {
+                if (componentSizes[id] > 0 && (smallest == -1 || componentSizes[id] < componentSizes[smallest]))
+                {
+                    smallest = id;
+                }
+            }
+            collectMembers(componentStarts[smallest]);
+
+            double bestDelta = std::numeric_limits<double>::max();
+            int bestU = -1, bestU2 = -1, bestW = -1, bestW2 = -1;
+            auto consider = [&](int u, int w)
+            {
+                if (component[w] == smallest)
+                {
+                    return;
+                }
+                for (int s = 0; s < 2; s++)
+                {
+                    int u2 = childLinks[2 * u + s];
+                    for (int t = 0; t < 2; t++)
+                    {
+                        int w2 = childLinks[2 * w + t];
+                        double removed = getDistance(u, u2) + getDistance(w, w2);
+                        double delta = getDistance(u, w) + getDistance(u2, w2) - removed;
+                        if (delta < bestDelta)
+                        {
+                            bestDelta = delta;
+                            bestU = u, bestU2 = u2, bestW = w, bestW2 = w2;
+                        }
+                    }
+                }
+            };
+            for (int u : members)
+            {
+                if (u == depot)
+                {
+                    continue;
+                }
+                consider(u, depot);
+                const int* neighbors = instance.getNeighbors(u);
+                for (int k = 0; k < instance.getNeighborsCount(); k++)
+                {
+                    consider(u, neighbors[k]);
+                }
+            }
+            if (bestU == -1)
+            {
+                for (int u : members)
+                {
+                    for (int w = 0; w < cycleSize; w++)
+                    {
+                        consider(u, w);
+                    }
+                }
+            }
+
+            // Both pairings of the two edge ends give one cycle, trying both links of w covers them
+            replaceLink(childLinks, bestU, bestU2, bestW);
+            replaceLink(childLinks, bestU2, bestU, bestW2);
+            replaceLink(childLinks, bestW, bestW2, bestU);
+            replaceLink(childLinks, bestW2, bestW, bestU2);
+
+            int target = component[bestW];
+            for (int member : members)
+            {
+                component[member] = target;
+            }
+            componentSizes[target] += componentSizes[smallest];
+            componentSizes[smallest] = 0;
+        }
+    }
+};
+
+enum class SolverMode
+{
+    GENETIC,
+    LOCAL_SEARCH,
+    EXACT
+};
+
+static SolverMode modeFromString(const std::string& str)
+{
+    if (str == "ga")
+        return SolverMode::GENETIC;
+    else if (str == "lk")
+        return SolverMode::LOCAL_SEARCH;
+    else if (str == "exact")
+        return SolverMode::EXACT;
+    else
+        throw std::invalid_argument("Invalid SolverMode string");
+}
+
+enum class SeedingStrategy
+{
+    RANDOM,
+    HILBERT,
+    NEAREST_NEIGHBOR,
+    GREEDY,
+    MIXED
+};
+
+static SeedingStrategy seedingFromString(const std::string& str)
+{
+    if (str == "random")
+        return SeedingStrategy::RANDOM;
+    else if (str == "hilbert")
+        return SeedingStrategy::HILBERT;
+    else if (str == "nn")
+        return SeedingStrategy::NEAREST_NEIGHBOR;
+    else if (str == "greedy")
+        return SeedingStrategy::GREEDY;
+    else if (str == "mixed")
+        return SeedingStrategy::MIXED;
+    else
+        throw std::invalid_argument("Invalid SeedingStrategy string");
+}
+
+enum class CrossoverType
+{
+    ORDER,
+    EDGE_ASSEMBLY
+};
+
+static CrossoverType crossoverFromString(const std::string& str)
+{
+    if (str == "order")
+        return CrossoverType::ORDER;
+    else if (str == "eax")
+        return CrossoverType::EDGE_ASSEMBLY;
+    else
+        throw std::invalid_argument("Invalid CrossoverType string");
+}
+
+enum class MigrationTopology
+{
+    RING,
+    RANDOM
+};
+
+static MigrationTopology topologyFromString(const std::string& str)
+{
+    if (str == "ring")
+        return MigrationTopology::RING;
+    else if (str == "random")
+        return MigrationTopology::RANDOM;
+    else
+        throw std::invalid_argument("Invalid MigrationTopology string");
+}
+
+struct TSPSettings
+{
+    SolverMode mode = SolverMode::GENETIC;
+    // -1 lets the iterated local search pick the number of kicks from the size
+    long long kicksCount = -1;
+    bool isSeededByLocalSearch = false;
+    SeedingStrategy seeding = SeedingStrategy::RANDOM;
+    bool isMemetic = false;
+    CrossoverType crossover = CrossoverType::ORDER;
+    int threadsCount = 1;
+    unsigned int seed = 0;
+    int islandsCount = 1;
+    int migrationInterval = 50;
+    MigrationTopology topology = MigrationTopology::RING;
+    // Zero disables the deadline and the improvement check
+    long long timeLimitMs = 0;
+    double minImprovement = 0.0;
+    long long improvementWindowMs = 1000;
+    bool isTracing = false;
+    // Known optimum that the trace reports the gap to, zero if unknown
+    double referenceWeight = 0.0;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    // Checkpoints are written every checkpointInterval generations when a path is given
+    std::string checkpointPath;
+    int checkpointInterval = 500;
+    std::string resumePath;
+    bool collectTelemetry = false;
+};
+
+// Wall-clock budget of one search, measured from the start of the program. The search stops at the
+// deadline, or once the best weight improved by less than the minImprovement fraction over the last
+// window. With tracing every new best weight is printed together with its time.
+// The workers of the search poll its deadline, which is also set when the search converges.
+class SearchBudget
+{
+private:
+    static const int PRINTS_COUNT = 10;
+    std::chrono::steady_clock::time_point startTime;
+    long long timeLimitMs;
+    Deadline deadline;
+    double minImprovement;
+    long long improvementWindowMs;
+    bool isTracing;
+    double referenceWeight;
+    double bestWeight = std::numeric_limits<double>::max();
+    double windowStartWeight = std::numeric_limits<double>::max();
+    long long windowStartMs = 0;
+    int printsCount = 0;
+public:
+    SearchBudget(const TSPSettings& settings, bool isTracing)
+        : startTime(settings.startTime), timeLimitMs(settings.timeLimitMs),
+          deadline(settings.startTime, settings.timeLimitMs), minImprovement(settings.minImprovement),
+          improvementWindowMs(settings.improvementWindowMs), isTracing(isTracing),
+          referenceWeight(settings.referenceWeight)
+    {
+    }
+
+    bool isTimed() const
+    {
+        return timeLimitMs > 0;
+    }
+
+    Deadline& getDeadline()
+    {
+        return deadline;
+    }
+
+    long long getElapsedMs() const
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    // Records the best weight after an iteration and returns whether the search should stop
+    bool update(double weight)
+    {
+        long long elapsedMs = getElapsedMs();
+        if (weight < bestWeight)
+        {
+            bestWeight = weight;
+            if (isTracing)
+            {
+                std::cout << "# TRACE: " << elapsedMs << " " << weight;
+                if (referenceWeight > 0.0)
+                {
+                    std::cout << " gap=" << 100.0 * (weight - referenceWeight) / referenceWeight << "%";
+                }
+                std::cout << "\n";
+            }
+        }
+        if (minImprovement > 0.0 && elapsedMs - windowStartMs >= improvementWindowMs)
+        {
+            if (windowStartWeight - bestWeight < minImprovement * windowStartWeight)
+            {
+                deadline.stop();
+                return true;
+            }
+            windowStartMs = elapsedMs;
+            windowStartWeight = bestWeight;
+        }
+        return deadline.hasPassed();
+    }
+
+    // The progress is printed at every tenth of the time limit
+    bool isPrintDue()
+    {
+        if (getElapsedMs() * PRINTS_COUNT >= printsCount * timeLimitMs)
+        {
+            printsCount++;
+            return true;
+        }
+        return false;
+    }
+};
+
+const int SearchBudget::PRINTS_COUNT;
+
+// Counters of the GA phases. Every worker has its own copy, padded to keep the copies on separate cache lines.
+struct PhaseStats
+{
+    long long crossoverNs = 0;
+    long long localSearchNs = 0;
+    long long selectionNs = 0;
+    long long restartNs = 0;
+    long long evaluations = 0;
+    long long mutations = 0;
+    long long restarts = 0;
+    long long migrants = 0;
+    char padding[64] = {};
+
+    void add(const PhaseStats& other)
+    {
+        crossoverNs += other.crossoverNs;
+        localSearchNs += other.localSearchNs;
+        selectionNs += other.selectionNs;
+        restartNs += other.restartNs;
+        evaluations += other.evaluations;
+        mutations += other.mutations;
+        restarts += other.restarts;
+        migrants += other.migrants;
+    }
+};
+
+// Adds the lifetime of the scope to the counter, reading the clock only when enabled
+class ScopedTimer
+{
+private:
+    long long& totalNs;
+    bool isEnabled;
+    std::chrono::steady_clock::time_point start;
+public:
+    ScopedTimer(long long& totalNs, bool isEnabled): totalNs(totalNs), isEnabled(isEnabled)
+    {
+        if (isEnabled)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedTimer()
+    {
+        if (isEnabled)
+        {
+            totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+        }
+    }
+};
+
+// Persistent workers that all run the same task and are waited for, the calling thread being worker 0
+class ThreadPool
+{
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    std::function<void(int)> task;
+    long long taskGeneration = 0;
+    int pendingWorkers = 0;
+    bool isStopping = false;
+public:
+    explicit ThreadPool(int threadsCount)
+    {
+        for (int worker = 1; worker < threadsCount; worker++)
+        {
+            threads.emplace_back([this, worker]() { workerLoop(worker); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopping = true;
+        }
+        workReady.notify_all();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    int getThreadsCount() const
+    {
+        return threads.size() + 1;
+    }
+
+    void run(const std::function<void(int)>& newTask)
+    {
+        if (threads.empty())
+        {
+            newTask(0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = newTask;
+            pendingWorkers = threads.size();
+            taskGeneration++;
+        }
+        workReady.notify_all();
+        newTask(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this]() { return pendingWorkers == 0; });
+    }
+
+private:
+    void workerLoop(int worker)
+    {
+        long long seenGeneration = 0;
+        while (true)
+        {
+            std::function<void(int)> currentTask;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                workReady.wait(lock, [&]() { return isStopping || taskGeneration != seenGeneration; });
+                if (isStopping)
+                {
+                    return;
+                }
+                seenGeneration = taskGeneration;
+                currentTask = task;
+            }
+            currentTask(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pendingWorkers == 0)
+                {
+                    workDone.notify_one();
+                }
+            }
+        }
+    }
+};
+
+// Uniform grid over the bounding box of a set of cities with about two cities per cell.
+// Cities can be removed, and the nearest remaining city is found by searching rings of cells.
+class SpatialGrid
+{
+private:
+    const TSPInstance& instance;
+    double minX = 0.0;
+    double minY = 0.0;
+    double cellSize = 1.0;
+    int cellsPerSide = 1;
+    int citiesCount;
+    std::vector<int> cellStart;
+    std::vector<int> cellCount;
+    std::vector<int> cellCities;
+    // Index of the city in cellCities, -1 if the city is not in the grid
+    std::vector<int> cityIndex;
+public:
+    SpatialGrid(const TSPInstance& instance, const std::vector<int>& cities)
+        : instance(instance), citiesCount(cities.size()), cellCities(cities.size()),
+          cityIndex(instance.getSize(), -1)
+    {
+        if (!cities.empty())
+        {
+            double maxX = instance.getX(cities[0]);
+            double maxY = instance.getY(cities[0]);
+            minX = maxX;
+            minY = maxY;
+            for (int city : cities)
+            {
+                minX = std::min(minX, instance.getX(city));
+                maxX = std::max(maxX, instance.getX(city));
+                minY = std::min(minY, instance.getY(city));
+                maxY = std::max(maxY, instance.getY(city));
+            }
+            cellsPerSide = std::max(1, (int)std::sqrt(cities.size() / 2.0));
+            cellSize = std::max(maxX - minX, maxY - minY) / cellsPerSide;
+            if (cellSize <= 0.0)
+            {
+                cellSize = 1.0;
+            }
+        }
+        cellStart.assign(cellsPerSide * cellsPerSide + 1, 0);
+        cellCount.assign(cellsPerSide * cellsPerSide, 0);
+        for (int city : cities)
+        {
+            cellCount[getCell(city)]++;
+        }
+        for (int cell = 0; cell < cellsPerSide * cellsPerSide; cell++)
+        {
+            cellStart[cell + 1] = cellStart[cell] + cellCount[cell];
+            cellCount[cell] = 0;
+        }
+        for (int city : cities)
+        {
+            int cell = getCell(city);
+            int index = cellStart[cell] + cellCount[cell]++;
+            cellCities[index] = city;
+            cityIndex[city] = index;
+        }
+    }
+
+    bool isEmpty() const
+    {
+        return citiesCount == 0;
+    }
+
+    bool contains(int city) const
+    {
+        return cityIndex[city] != -1;
+    }
+
+    void remove(int city)
+    {
+        int cell = getCell(city);
+        int index = cityIndex[city];
+        int lastIndex = cellStart[cell] + --cellCount[cell];
+        int last = cellCities[lastIndex];
+        cellCities[index] = last;
+        cityIndex[last] = index;
+        cityIndex[city] = -1;
+        citiesCount--;
+    }
+
+    // The closest city still in the grid, -1 if the grid is empty
+    int findNearest(int city) const
+    {
+        int cellX = getCellCoordinate(instance.getX(city), minX);
+        int cellY = getCellCoordinate(instance.getY(city), minY);
+        int nearest = -1;
+        double nearestDistance = std::numeric_limits<double>::max();
+        for (int ring = 0; ring <= cellsPerSide && citiesCount > 0; ring++)
+        {
+            for (int y = cellY - ring; y <= cellY + ring; y++)
+            {
+                if (y < 0 || y >= cellsPerSide)
+                {
+                    continue;
+                }
+                bool isEdgeRow = (y == cellY - ring || y == cellY + ring);
+                for (int x = cellX - ring; x <= cellX + ring; x += (isEdgeRow || ring == 0) ? 1 : 2 * ring)
+                {
+                    if (x < 0 || x >= cellsPerSide)
+                    {
+                        continue;
+                    }
+                    int cell = y * cellsPerSide + x;
+                    for (int k = cellStart[cell]; k < cellStart[cell] + cellCount[cell]; k++)
+                    {
+                        int other = cellCities[k];
+                        double dx = instance.getX(city) - instance.getX(other);
+                        double dy = instance.getY(city) - instance.getY(other);
+                        double squaredDistance = dx * dx + dy * dy;
+                        if (other != city && squaredDistance < nearestDistance)
+                        {
+                            nearestDistance = squaredDistance;
+                            nearest = other;
+                        }
+                    }
+                }
+            }
+            double reach = ring * cellSize;
+            if (nearest != -1 && nearestDistance <= reach * reach)
+            {
+                break;
+            }
+        }
+        return nearest;
+    }
+
+private:
+    int getCellCoordinate(double coordinate, double minCoordinate) const
+    {
+        return std::max(0, std::min(cellsPerSide - 1, (int)((coordinate - minCoordinate) / cellSize)));
+    }
+
+    int getCell(int city) const
+    {
+        return getCellCoordinate(instance.getY(city), minY) * cellsPerSide + getCellCoordinate(instance.getX(city), minX);
+    }
+};
+
+// Constructive heuristics for good starting paths
+class TourConstruction
+{
+private:
+    static const int HILBERT_ORDER = 16;
+    static const int PERTURBATION_DIVISOR = 50;
+    static const int MAX_PERTURBATION_LENGTH = 10;
+public:
+    // Cities sorted by their position along a Hilbert curve over the bounding box
+    static std::vector<int> makeHilbertPath(const TSPInstance& instance)
+    {
+        int n = instance.getSize();
+        std::vector<int> nodes(n);
+        std::iota(nodes.begin(), nodes.end(), 0);
+        if (n == 0)
+        {
+            return nodes;
+        }
+        double minX = instance.getX(0), maxX = minX, minY = instance.getY(0), maxY = minY;
+        for (int city = 1; city < n; city++)
+        {
+            minX = std::min(minX, instance.getX(city));
+            maxX = std::max(maxX, instance.getX(city));
+            minY = std::min(minY, instance.getY(city));
+            maxY = std::max(maxY, instance.getY(city));
+        }
+        int side = 1 << HILBERT_ORDER;
+        double scale = (side - 1) / std::max(std::max(maxX - minX, maxY - minY), 1e-12);
+        std::vector<unsigned long long> keys(n);
+        for (int city = 0; city < n; city++)
+        {
+            keys[city] = getHilbertIndex((unsigned int)((instance.getX(city) - minX) * scale),
+                                         (unsigned int)((instance.getY(city) - minY) * scale));
+        }
+        std::sort(nodes.begin(), nodes.end(), [&keys](int city1, int city2) { return keys[city1] < keys[city2]; });
+        return nodes;
+    }
+
+    // Greedy walk to the closest unvisited city, checking the candidate neighbours first and
+    // falling back to the spatial grid when all of them are visited
+    static std::vector<int> makeNearestNeighborPath(const TSPInstance& instance, int start)
+    {
+        int n = instance.getSize();
+        std::vector<int> nodes;
+        nodes.reserve(n);
+        if (n == 0)
+        {
+            return nodes;
+        }
+        std::vector<int> cities(n);
+        std::iota(cities.begin(), cities.end(), 0);
+        SpatialGrid unvisited(instance, cities);
+        int current = start;
+        while (true)
+        {
+            unvisited.remove(current);
+            nodes.push_back(current);
+            if (unvisited.isEmpty())
+            {
+                break;
+            }
+            int next = -1;
+            const int* neighbors = instance.getNeighbors(current);
+            for (int k = 0; k < instance.getNeighborsCount() && next == -1; k++)
+            {
+                if (unvisited.contains(neighbors[k]))
+                {
+                    next = neighbors[k];
+                }
+            }
+            current = next != -1 ? next : unvisited.findNearest(current);
+        }
+        return nodes;
+    }
+
+    // Greedy edge matching: candidate edges are taken shortest first as long as no city gets a
+    // third edge and no cycle closes. The resulting fragments are chained nearest end first.
+    static std::vector<int> makeGreedyPath(const TSPInstance& instance)
+    {
+        struct Edge
+        {
+            double length;
+            int from;
+            int to;
+        };
+        int n = instance.getSize();
+        std::vector<Edge> edges;
+        edges.reserve((size_t)n * instance.getNeighborsCount());
+        for (int city = 0; city < n; city++)
+        {
+            const int* neighbors = instance.getNeighbors(city);
+            for (int k = 0; k < instance.getNeighborsCount(); k++)
+            {
+                int other = neighbors[k];
+                const int* otherNeighbors = instance.getNeighbors(other);
+                bool isListedByOther = std::find(otherNeighbors, otherNeighbors + instance.getNeighborsCount(), city)
+                                       != otherNeighbors + instance.getNeighborsCount();
+                if (city < other || !isListedByOther)
+                {
+                    edges.push_back({instance.getDistance(city, other), city, other});
+                }
+            }
+        }
+        std::sort(edges.begin(), edges.end(), [](const Edge& edge1, const Edge& edge2)
+        {
+            return edge1.length < edge2.length;
+        });
+
+        std::vector<int> links(2 * n, -1);
+        std::vector<int> parents(n);
+        std::iota(parents.begin(), parents.end(), 0);
+        auto findRoot = [&parents](int city)
+        {
+            while (parents[city] != city)
+            {
+                parents[city] = parents[parents[city]];
+                city = parents[city];
+            }
+            return city;
+        };
+        auto getDegree = [&links](int city) { return (links[2 * city] != -1) + (links[2 * city + 1] != -1); };
+        for (const Edge& edge : edges)
+        {
+            if (getDegree(edge.from) == 2 || getDegree(edge.to) == 2)
+            {
+                continue;
+            }
+            int root1 = findRoot(edge.from);
+            int root2 = findRoot(edge.to);
+            if (root1 == root2)
+            {
+                continue;
+            }
+            parents[root1] = root2;
+            links[2 * edge.from + (links[2 * edge.from] == -1 ? 0 : 1)] = edge.to;
+            links[2 * edge.to + (links[2 * edge.to] == -1 ? 0 : 1)] = edge.from;
+        }
+
+        std::vector<int> ends;
+        for (int city = 0; city < n; city++)
+        {
+            if (getDegree(city) < 2)
+            {
+                ends.push_back(city);
+            }
+        }
+        SpatialGrid fragmentEnds(instance, ends);
+        std::vector<int> nodes;
+        nodes.reserve(n);
+        int current = ends.empty() ? -1 : ends[0];
+        while (current != -1)
+        {
+            fragmentEnds.remove(current);
+            int previous = -1;
+            int city = current;
+            while (true)
+            {
+                nodes.push_back(city);
+                int next = links[2 * city] != previous ? links[2 * city] : links[2 * city + 1];
+                if (next == -1 || next == previous)
+                {
+                    break;
+                }
+                previous = city;
+                city = next;
+            }
+            if (city != current)
+            {
+                fragmentEnds.remove(city);
+            }
+            current = fragmentEnds.isEmpty() ? -1 : fragmentEnds.findNearest(city);
+        }
+        return nodes;
+    }
+
+    // A few random reversals of short segments, keeping most of the path intact
+    static void perturb(int* nodes, int size, std::mt19937& rng)
+    {
+        if (size < 2)
+        {
+            return;
+        }
+        int movesCount = std::max(1, size / PERTURBATION_DIVISOR);
+        int maxLength = std::min(MAX_PERTURBATION_LENGTH, size);
+        for (int move = 0; move < movesCount; move++)
+        {
+            int start = std::uniform_int_distribution<int>(0, size - 2)(rng);
+            int length = std::uniform_int_distribution<int>(2, maxLength)(rng);
+            std::reverse(nodes + start, nodes + std::min(start + length, size));
+        }
+    }
+
+private:
+    static unsigned long long getHilbertIndex(unsigned int x, unsigned int y)
+    {
+        unsigned long long index = 0;
+        for (unsigned int half = 1u << (HILBERT_ORDER - 1); half > 0; half >>= 1)
+        {
+            unsigned int rx = (x & half) > 0;
+            unsigned int ry = (y & half) > 0;
+            index += (unsigned long long)half * half * ((3 * rx) ^ ry);
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = half - 1 - x;
+                    y = half - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return index;
+    }
+};
+
+const int TourConstruction::HILBERT_ORDER;
+const int TourConstruction::PERTURBATION_DIVISOR;
+const int TourConstruction::MAX_PERTURBATION_LENGTH;
+
+// Standalone optimizer: a nearest neighbour path improved by 2-opt and Or-opt, then kicked with
+// local double bridges. A kick is kept only if the local search after it more than pays for it,
+// otherwise its moves are undone.
+class IteratedLocalSearch
+{
+private:
+    static const int KICKS_COEF = 20;
+    static const int KICKS_TO_PRINT = 10;
+    static constexpr double EPSILON = 1e-10;
+    const TSPInstance& instance;
+    TSPSettings settings;
+    LocalSearch localSearch;
+    std::mt19937 rng;
+    long long kicksCount;
+public:
+    // Without an explicit number of kicks a timed standalone search runs until its deadline
+    IteratedLocalSearch(const TSPInstance& instance, const TSPSettings& settings)
+        : instance(instance), settings(settings), localSearch(instance), rng(settings.seed)
+    {
+        kicksCount = (long long)KICKS_COEF * instance.getSize();
+        if (settings.kicksCount >= 0)
+        {
+            kicksCount = settings.kicksCount;
+        }
+        else if (settings.timeLimitMs > 0 && settings.mode == SolverMode::LOCAL_SEARCH)
+        {
+            kicksCount = std::numeric_limits<long long>::max();
+        }
+    }
+
+    Path findBestPath(bool shouldPrint = false)
+    {
+        std::vector<int> nodes = TourConstruction::makeNearestNeighborPath(instance, 0);
+        if (!localSearch.isApplicable())
+        {
+            return findBestPermutation(std::move(nodes));
+        }
+        SearchBudget budget(settings, shouldPrint && settings.isTracing);
+        localSearch.load(nodes.data());
+        double weight = instance.getPathWeight(nodes.data()) - localSearch.optimize(&budget.getDeadline());
+        localSearch.commit();
+
+        long long printKickInterval = std::max(1LL, kicksCount / KICKS_TO_PRINT);
+        for (long long kick = 0; kick < kicksCount; kick++)
+        {
+            double delta = localSearch.kick(rng) - localSearch.optimize(&budget.getDeadline());
+            if (delta < -EPSILON)
+            {
+                weight += delta;
+                localSearch.commit();
+            }
+            else
+            {
+                localSearch.revert();
+            }
+            bool isFinished = budget.update(weight) || kick == kicksCount - 1;
+            bool isPrintDue = budget.isTimed() ? budget.isPrintDue() : kick % printKickInterval == 0;
+            if (shouldPrint && (isPrintDue || isFinished))
+            {
+                std::cout << weight << std::endl;
+            }
+            if (isFinished)
+            {
+                break;
+            }
+        }
+        localSearch.store(nodes.data());
+        double finalWeight = instance.getPathWeight(nodes.data());
+        return Path(std::move(nodes), finalWeight);
+    }
+
+private:
+    // Too few cities for the local search, so every order is tried instead
+    Path findBestPermutation(std::vector<int> nodes) const
+    {
+        std::sort(nodes.begin(), nodes.end());
+        std::vector<int> bestNodes = nodes;
+        double bestWeight = instance.getPathWeight(nodes.data());
+        while (std::next_permutation(nodes.begin(), nodes.end()))
+        {
+            double weight = instance.getPathWeight(nodes.data());
+            if (weight < bestWeight)
+            {
+                bestWeight = weight;
+                bestNodes = nodes;
+            }
+        }
+        return Path(std::move(bestNodes), bestWeight);
+    }
+};
+
+const int IteratedLocalSearch::KICKS_COEF;
+const int IteratedLocalSearch::KICKS_TO_PRINT;
+constexpr double IteratedLocalSearch::EPSILON;
+
+// Exact open path by dynamic programming over subsets in O(n^2 2^n) time. A state (subset, last city)
+// is stored without the bit of its last city, so the table holds n 2^(n-1) floats. The subsets of
+// one size only depend on the smaller ones, so every layer is split among the threads.
+class HeldKarpSolver
+{
+private:
+    static const int MAX_SIZE = 23;
+    const TSPInstance& instance;
+    int n;
+    std::vector<float> distances;
+    std::vector<float> costs;
+    ThreadPool threadPool;
+public:
+    HeldKarpSolver(const TSPInstance& instance, int threadsCount)
+        : instance(instance), n(instance.getSize()), threadPool(threadsCount)
+    {
+    }
+
+    static int getMaxSize()
+    {
+        return MAX_SIZE;
+    }
+
+    Path findBestPath()
+    {
+        if (n > MAX_SIZE)
+        {
+            throw std::invalid_argument("Held-Karp supports at most " + std::to_string(MAX_SIZE) + " cities");
+        }
+        std::vector<int> nodes(n);
+        std::iota(nodes.begin(), nodes.end(), 0);
+        if (n <= 2)
+        {
+            double weight = instance.getPathWeight(nodes.data());
+            return Path(std::move(nodes), weight);
+        }
+
+        distances.resize(n * n);
+        for (int from = 0; from < n; from++)
+        {
+            for (int to = 0; to < n; to++)
+            {
+                distances[from * n + to] = instance.getDistance(from, to);
+            }
+        }
+        costs.assign((size_t)n << (n - 1), std::numeric_limits<float>::max());
+        for (int last = 0; last < n; last++)
+        {
+            costs[getIndex(1u << last, last)] = 0.0f;
+        }
+        unsigned int subsetsCount = 1u << n;
+        int threadsCount = threadPool.getThreadsCount();
+        for (int layer = 2; layer <= n; layer++)
+        {
+            threadPool.run([&](int worker)
+            {
+                unsigned int begin = (unsigned long long)subsetsCount * worker / threadsCount;
+                unsigned int end = (unsigned long long)subsetsCount * (worker + 1) / threadsCount;
+                for (unsigned int subset = begin; subset < end; subset++)
+                {
+                    if ((int)std::bitset<32>(subset).count() != layer)
+                    {
+                        continue;
+                    }
+                    for (int last = 0; last < n; last++)
+                    {
+                        if (subset & (1u << last))
+                        {
+                            costs[getIndex(subset, last)] = getBestPrevious(subset ^ (1u << last), last).second;
+                        }
+                    }
+                }
+            });
+        }
+
+        unsigned int subset = subsetsCount - 1;
+        int last = 0;
+        for (int city = 1; city < n; city++)
+        {
+            if (costs[getIndex(subset, city)] < costs[getIndex(subset, last)])
+            {
+                last = city;
+            }
+        }
+        for (int k = n - 1; k > 0; k--)
+        {
+            nodes[k] = last;
+            subset ^= 1u << last;
+            last = getBestPrevious(subset, last).first;
+        }
+        nodes[0] = last;
+        double weight = instance.getPathWeight(nodes.data());
+        return Path(std::move(nodes), weight);
+    }
+
+private:
+    size_t getIndex(unsigned int subset, int last) const
+    {
+        unsigned int lower = subset & ((1u << last) - 1);
+        unsigned int upper = (subset >> (last + 1)) << last;
+        return ((size_t)last << (n - 1)) | (upper | lower);
+    }
+
+    // The best city to come from into last after visiting the subset, with the resulting cost
+    std::pair<int, float> getBestPrevious(unsigned int subset, int last) const
+    {
+        std::pair<int, float> best(-1, std::numeric_limits<float>::max());
+        for (int previous = 0; previous < n; previous++)
+        {
+            if (subset & (1u << previous))
+            {
+                float cost = costs[getIndex(subset, previous)] + distances[previous * n + last];
+                if (cost < best.second)
+                {
+                    best = {previous, cost};
+                }
+            }
+        }
+        return best;
+    }
+};
+
+const int HeldKarpSolver::MAX_SIZE;
+
+// Tours of a whole generation stored back to back, slot i occupying nodes [i * size, (i + 1) * size)
+class PopulationArena
+{
+private:
+    int size;
+    std::vector<int> nodes;
+    std::vector<double> weights;
+public:
+    PopulationArena(int size, int slotsCount)
+        : size(size), nodes(static_cast<size_t>(size) * slotsCount), weights(slotsCount) {}
+
+    int* getNodes(int slot)
+    {
+        return nodes.data() + static_cast<size_t>(slot) * size;
+    }
+
+    const int* getNodes(int slot) const
+    {
+        return nodes.data() + static_cast<size_t>(slot) * size;
+    }
+
+    double& getWeight(int slot)
+    {
+        return weights[slot];
+    }
+
+    double getWeight(int slot) const
+    {
+        return weights[slot];
+    }
+
+    void copySlot(const PopulationArena& source, int sourceSlot, int slot)
+    {
+        std::copy(source.getNodes(sourceSlot), source.getNodes(sourceSlot) + size, getNodes(slot));
+        weights[slot] = source.weights[sourceSlot];
+    }
+
+    Path toPath(int slot) const
+    {
+        return Path(std::vector<int>(getNodes(slot), getNodes(slot) + size), weights[slot]);
+    }
+};
+
+class TSPGeneticSolver
+{
+private:
+    static const int POPULATION_KEEP = 2;
+    static const int POPULATION_KEEP_RESTART_PERCENTAGE = 2;
+    static const int MAX_GENERATIONS = 10000;
+    static const int STAGNATION_COEF = 2;
+    static const int GENERATIONS_TO_PRINT = 10;
+    static const int MUTATION_PERCENTAGE = 5;
+    static const int CHECKPOINT_VERSION = 1;
+    static const char CHECKPOINT_MAGIC[8];
+    const TSPInstance& instance;
+    TSPSettings settings;
+    int populationSize = 100;
+    // The population and the offspring swap roles every generation. The rankings hold the arena
+    // slots with the populationSize alive ones first, of which only the elite prefix is sorted by weight.
+    PopulationArena population;
+    PopulationArena offspring;
+    std::vector<int> ranking;
+    std::vector<int> offspringRanking;
+    std::mt19937 rng;
+    std::vector<std::mt19937> workerRngs;
+    std::vector<LocalSearch> localSearches;
+    std::vector<std::vector<char>> workerTaken;
+    std::vector<EdgeAssemblyCrossover> edgeAssemblies;
+    // Constructed paths that new population members perturb, empty for random seeding
+    std::vector<std::vector<int>> seedPaths;
+    long long seedsUsed = 0;
+    // New paths of a restart, evaluated together
+    std::vector<const int*> newPaths;
+    std::vector<double> newWeights;
+    // Where a resumed run continues
+    int firstGeneration = 0;
+    int resumedStagnationCounter = 0;
+    PhaseStats stats;
+    std::vector<PhaseStats> workerStats;
+    ThreadPool threadPool;
+public:
+    TSPGeneticSolver(const TSPInstance& instance, const TSPSettings& settings)
+        : instance(instance), settings(settings),
+          population(instance.getSize(), populationSize + POPULATION_KEEP),
+          offspring(instance.getSize(), populationSize + POPULATION_KEEP),
+          ranking(populationSize + POPULATION_KEEP), offspringRanking(populationSize + POPULATION_KEEP),
+          rng(settings.seed), threadPool(settings.threadsCount)
+    {
+        for (int worker = 0; worker < settings.threadsCount; worker++)
+        {
+            std::seed_seq workerSeed{settings.seed, static_cast<unsigned int>(worker + 1)};
+            workerRngs.emplace_back(workerSeed);
+            localSearches.emplace_back(instance);
+            workerTaken.emplace_back(instance.getSize());
+            workerStats.emplace_back();
+            if (settings.crossover == CrossoverType::EDGE_ASSEMBLY)
+            {
+                edgeAssemblies.emplace_back(instance);
+            }
+        }
+        std::iota(ranking.begin(), ranking.end(), 0);
+        makeSeedPaths();
+        addRandomPopulation(populationSize);
+        if (settings.isSeededByLocalSearch && instance.getSize() > 2)
+        {
+            acceptMigrant(IteratedLocalSearch(instance, settings).findBestPath());
+        }
+        if (!settings.resumePath.empty())
+        {
+            loadCheckpoint();
+        }
+    }
+
+    // The callback runs after every generation, the island model uses it for migration
+    Path findBestPath(bool shouldPrint = false,
+                      const std::function<void(TSPGeneticSolver&, int)>& afterGeneration = nullptr)
+    {
+        if (instance.getSize() <= 2)
+        {
+            return bestPathBaseCase();
+        }
+        SearchBudget budget(settings, shouldPrint && settings.isTracing);
+        int maxGenerations = budget.isTimed() ? std::numeric_limits<int>::max() : MAX_GENERATIONS;
+        int printGenerationInterval = maxGenerations / GENERATIONS_TO_PRINT;
+        double lastBestWeight = population.getWeight(ranking[0]);
+        int stagnationCounter = resumedStagnationCounter;
+        int stagnationMax = STAGNATION_COEF * instance.getSize();
+        for (int generation = firstGeneration; generation < maxGenerations; generation++)
+        {
+            makeChildren(populationSize, budget.getDeadline());
+            {
+                ScopedTimer timer(stats.selectionNs, settings.collectTelemetry);
+                for (int k = 0; k < POPULATION_KEEP; k++)
+                {
+                    offspring.copySlot(population, ranking[k], populationSize + k);
+                }
+                std::iota(offspringRanking.begin(), offspringRanking.end(), 0);
+                selectBest(offspring, offspringRanking, offspringRanking.size(), populationSize);
+                std::swap(population, offspring);
+                std::swap(ranking, offspringRanking);
+            }
+
+            double bestWeight = population.getWeight(ranking[0]);
+            if (bestWeight < lastBestWeight)
+            {
+                lastBestWeight = bestWeight;
+                stagnationCounter = 0;
+            }
+            else
+            {
+                stagnationCounter++;
+                if (stagnationCounter >= stagnationMax)
+                {
+                    ScopedTimer timer(stats.restartNs, settings.collectTelemetry);
+                    addRandomPopulation(populationSize * (100 - POPULATION_KEEP_RESTART_PERCENTAGE) / 100);
+                    stats.restarts++;
+                    stagnationCounter = 0;
+                }
+            }
+            if (afterGeneration)
+            {
+                afterGeneration(*this, generation);
+            }
+            bool isFinished = budget.update(population.getWeight(ranking[0])) || generation == maxGenerations - 1;
+            bool isPrintDue = budget.isTimed() ? budget.isPrintDue() : generation % printGenerationInterval == 0;
+            if (shouldPrint && (isPrintDue || isFinished))
+            {
+                std::cout << population.getWeight(ranking[0]) << std::endl;
+            }
+            if (settings.collectTelemetry && (isPrintDue || isFinished))
+            {
+                printStats(generation, isFinished);
+            }
+            if (!settings.checkpointPath.empty() && ((generation + 1) % settings.checkpointInterval == 0 || isFinished))
+            {
+                saveCheckpoint(generation, stagnationCounter);
+            }
+            if (isFinished)
+            {
+                break;
+            }
+        }
+        return getBestPath();
+    }
+
+    Path getBestPath() const
+    {
+        return population.toPath(ranking[0]);
+    }
+
+    // The migrant replaces the worst path if it is better and not already present
+    void acceptMigrant(const Path& migrant)
+    {
+        auto alive = ranking.begin() + populationSize;
+        auto worst = std::max_element(ranking.begin(), alive, [this](int slot1, int slot2)
+        {
+            return population.getWeight(slot1) < population.getWeight(slot2);
+        });
+        if (!(migrant.totalWeight < population.getWeight(*worst)))
+        {
+            return;
+        }
+        for (auto slot = ranking.begin(); slot != alive; ++slot)
+        {
+            if (population.getWeight(*slot) == migrant.totalWeight)
+            {
+                return;
+            }
+        }
+        std::copy(migrant.nodes.begin(), migrant.nodes.end(), population.getNodes(*worst));
+        population.getWeight(*worst) = migrant.totalWeight;
+        stats.migrants++;
+        selectBest(population, ranking, populationSize, populationSize);
+    }
+
+private:
+
+    static int getRandomIndex(int size, std::mt19937& workerRng)
+    {
+        return std::uniform_int_distribution<int>(0, size - 1)(workerRng);
+    }
+
+    // Moves the bestCount lightest of the first candidatesCount slots to the front in O(P) and sorts
+    // only the elites among them, instead of sorting the whole population every generation
+    static void selectBest(const PopulationArena& arena, std::vector<int>& slots, int candidatesCount, int bestCount)
+    {
+        auto isLighter = [&arena](int slot1, int slot2) { return arena.getWeight(slot1) < arena.getWeight(slot2); };
+        if (bestCount < candidatesCount)
+        {
+            std::nth_element(slots.begin(), slots.begin() + bestCount, slots.begin() + candidatesCount, isLighter);
+        }
+        std::partial_sort(slots.begin(), slots.begin() + std::min(POPULATION_KEEP, bestCount),
+                          slots.begin() + bestCount, isLighter);
+    }
+
+    // Returns whether the path was mutated
+    bool mutate(int* nodes, double& weight, std::mt19937& workerRng) const
+    {
+        bool shouldMutateSwap = getRandomIndex(100, workerRng) < MUTATION_PERCENTAGE;
+        if (shouldMutateSwap)
+        {
+            int size = instance.getSize();
+            int index1 = getRandomIndex(size, workerRng);
+            int index2 = getRandomIndex(size, workerRng);
+            if (index1 == index2)
+            {
+                index2 = (index2 + 1) % size;
+            }
+            weight += getSwapDelta(nodes, index1, index2);
+            std::swap(nodes[index1], nodes[index2]);
+        }
+        return shouldMutateSwap;
+    }
+
+    // Returns the arena slot of the selected path
+    int tournamentSelect(std::mt19937& workerRng) const
+    {
+        int tournamentSize = 3;
+        int bestSlot = ranking[getRandomIndex(populationSize, workerRng)];
+        for (int j = 1; j < tournamentSize - 1; j++)
+        {
+            int currSlot = ranking[getRandomIndex(populationSize, workerRng)];
+            if (population.getWeight(currSlot) < population.getWeight(bestSlot))
+            {
+                bestSlot = currSlot;
+            }
+        }
+        return bestSlot;
+    }
+
+    // Every worker makes, mutates and improves a fixed slice of the children with its own RNG,
+    // so the result only depends on the seed and the number of threads. After the deadline
+    // the remaining children are copies of the alive paths, so the generation ends at once.
+    void makeChildren(int childrenCount, Deadline& deadline)
+    {
+        int threadsCount = threadPool.getThreadsCount();
+        threadPool.run([&](int worker)
+        {
+            std::mt19937& workerRng = workerRngs[worker];
+            PhaseStats& workerStat = workerStats[worker];
+            int begin = (long long)childrenCount * worker / threadsCount;
+            int end = (long long)childrenCount * (worker + 1) / threadsCount;
+            for (int i = begin; i < end; i++)
+            {
+                if (deadline.hasPassed())
+                {
+                    offspring.copySlot(population, ranking[i], i);
+                    continue;
+                }
+                int parent1 = tournamentSelect(workerRng);
+                int parent2 = tournamentSelect(workerRng);
+                int* child = offspring.getNodes(i);
+                double& childWeight = offspring.getWeight(i);
+                {
+                    ScopedTimer timer(workerStat.crossoverNs, settings.collectTelemetry);
+                    if (settings.crossover == CrossoverType::EDGE_ASSEMBLY)
+                    {
+                        edgeAssemblies[worker].cross(population.getNodes(parent1), population.getNodes(parent2),
+                                                     child, workerRng);
+                        childWeight = getPathWeight(child);
+                    }
+                    else
+                    {
+                        childWeight = makeChild(population.getNodes(parent1), population.getNodes(parent2), child,
+                                                workerTaken[worker], workerRng);
+                    }
+                }
+                workerStat.evaluations++;
+                if (mutate(child, childWeight, workerRng))
+                {
+                    workerStat.mutations++;
+                }
+                if (settings.isMemetic)
+                {
+                    ScopedTimer timer(workerStat.localSearchNs, settings.collectTelemetry);
+                    childWeight -= localSearches[worker].improve(child, &deadline);
+                }
+            }
+        });
+    }
+
+    // Order crossover into the child slot, returns the child weight
+    double makeChild(const int* parent1, const int* parent2, int* child, std::vector<char>& taken,
+                     std::mt19937& workerRng) const
+    {
+        int size = instance.getSize();
+        int i = getRandomIndex(size, workerRng);
+        int j = getRandomIndex(size, workerRng);
+        while (i == j)
+        {
+            j = getRandomIndex(size, workerRng);
+        }
+        if (i > j) std::swap(i, j);
+
+        std::fill(taken.begin(), taken.end(), 0);
+        for (int k = i; k <= j; k++)
+        {
+            child[k] = parent1[k];
+            taken[parent1[k]] = 1;
+        }
+
+        int currentIndex1 = (j + 1) % size;
+
+        for (int k = 0; k < size; k++)
+        {
+            int parent2Node = parent2[(j + 1 + k) % size];
+            if (!taken[parent2Node])
+            {
+                child[currentIndex1] = parent2Node;
+                currentIndex1 = (currentIndex1 + 1) % size;
+            }
+        }
+        return getPathWeight(child);
+    }
+
+    void makeSeedPaths()
+    {
+        SeedingStrategy seeding = settings.seeding;
+        if (seeding == SeedingStrategy::HILBERT || seeding == SeedingStrategy::MIXED)
+        {
+            seedPaths.push_back(TourConstruction::makeHilbertPath(instance));
+        }
+        if ((seeding == SeedingStrategy::NEAREST_NEIGHBOR || seeding == SeedingStrategy::MIXED) && instance.getSize() > 0)
+        {
+            seedPaths.push_back(TourConstruction::makeNearestNeighborPath(instance, getRandomIndex(instance.getSize(), rng)));
+        }
+        if (seeding == SeedingStrategy::GREEDY || seeding == SeedingStrategy::MIXED)
+        {
+            seedPaths.push_back(TourConstruction::makeGreedyPath(instance));
+        }
+    }
+
+    // Replaces the worst randomCount alive paths, or fills the whole population at the start.
+    // With seed paths every new path is a perturbed seed path, except that each seed path
+    // enters the first population once unchanged.
+    void addRandomPopulation(int randomCount)
+    {
+        int size = instance.getSize();
+        selectBest(population, ranking, populationSize, populationSize - randomCount);
+        newPaths.reserve(populationSize);
+        int previousSlot = -1;
+        for (int i = populationSize - randomCount; i < populationSize; i++)
+        {
+            int slot = ranking[i];
+            int* nodes = population.getNodes(slot);
+            if (!seedPaths.empty())
+            {
+                const std::vector<int>& seedPath = seedPaths[seedsUsed % seedPaths.size()];
+                std::copy(seedPath.begin(), seedPath.end(), nodes);
+                if (seedsUsed >= (long long)seedPaths.size())
+                {
+                    TourConstruction::perturb(nodes, size, rng);
+                }
+                seedsUsed++;
+                newPaths.push_back(nodes);
+                continue;
+            }
+            if (previousSlot == -1)
+            {
+                std::iota(nodes, nodes + size, 0);
+            }
+            else
+            {
+                std::copy(population.getNodes(previousSlot), population.getNodes(previousSlot) + size, nodes);
+            }
+            std::shuffle(nodes, nodes + size, rng);
+            newPaths.push_back(nodes);
+            previousSlot = slot;
+        }
+        newWeights.resize(newPaths.size());
+        instance.getPathWeights(newPaths.data(), newPaths.size(), newWeights.data());
+        stats.evaluations += newPaths.size();
+        for (int i = populationSize - randomCount; i < populationSize; i++)
+        {
+            population.getWeight(ranking[i]) = newWeights[i - (populationSize - randomCount)];
+        }
+        newPaths.clear();
+
+        selectBest(population, ranking, populationSize, populationSize);
+    }
+
+    // Binary checkpoint: magic, version, instance size and fingerprint, generation, stagnation counter,
+    // used seed paths, the alive paths in ranking order as weight and nodes, and the RNG states in their text form.
+    // It is written to a temporary file first, so an interruption leaves the previous one intact.
+    // A failed write only prints a warning, the run goes on and the next interval tries again.
+    void saveCheckpoint(int generation, int stagnationCounter) const
+    {
+        std::string temporaryPath = settings.checkpointPath + ".tmp";
+        if (!writeCheckpoint(temporaryPath, generation, stagnationCounter))
+        {
+            std::cerr << "Warning: cannot write checkpoint " << temporaryPath << std::endl;
+            std::remove(temporaryPath.c_str());
+            return;
+        }
+#ifdef _WIN32
+        std::remove(settings.checkpointPath.c_str());
+#endif
+        if (std::rename(temporaryPath.c_str(), settings.checkpointPath.c_str()) != 0)
+        {
+            std::cerr << "Warning: cannot replace checkpoint " << settings.checkpointPath << std::endl;
+            std::remove(temporaryPath.c_str());
+        }
+    }
+
+    // Returns whether the whole checkpoint reached the file
+    bool writeCheckpoint(const std::string& path, int generation, int stagnationCounter) const
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+        int size = instance.getSize();
+        file.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        writeValue(file, CHECKPOINT_VERSION);
+        writeValue(file, size);
+        writeValue(file, instance.getFingerprint());
+        writeValue(file, generation);
+        writeValue(file, stagnationCounter);
+        writeValue(file, seedsUsed);
+        writeValue(file, populationSize);
+        for (int i = 0; i < populationSize; i++)
+        {
+            writeValue(file, population.getWeight(ranking[i]));
+            file.write(reinterpret_cast<const char*>(population.getNodes(ranking[i])), sizeof(int) * size);
+        }
+        std::vector<const std::mt19937*> rngs = {&rng};
+        for (const std::mt19937& workerRng : workerRngs)
+        {
+            rngs.push_back(&workerRng);
+        }
+        writeValue(file, (int)rngs.size());
+        for (const std::mt19937* savedRng : rngs)
+        {
+            std::ostringstream state;
+            state << *savedRng;
+            writeValue(file, (int)state.str().size());
+            file.write(state.str().data(), state.str().size());
+        }
+        file.close();
+        return !file.fail();
+    }
+
+    // A checkpoint of the same instance resumes the run with its generation and RNG states.
+    // For a different instance only its paths are reused, as a warm start. Every length read from
+    // the file is checked against the bytes left in it before anything is allocated.
+    void loadCheckpoint()
     {
-        if (points.size() <= 2)
+        std::ifstream file(settings.resumePath, std::ios::binary);
+        char magic[sizeof(CHECKPOINT_MAGIC)];
+        if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC)
+            || readValue<int>(file) != CHECKPOINT_VERSION)
         {
-            return bestPathBaseCase();
+            throw std::runtime_error("Not a TSP checkpoint: " + settings.resumePath);
         }
-        int maxGenerations = MAX_GENERATIONS;
-        int printGenerationInterval = maxGenerations / GENERATIONS_TO_PRINT;
-        double lastBestWeight = population[0].totalWeight;
-        int stagnationCounter = 0;
-        int stagnationMax = STAGNATION_COEF * points.size();
-        for (int generation = 0; generation < maxGenerations; generation++)
+        int size = readValue<int>(file);
+        unsigned long long fingerprint = readValue<unsigned long long>(file);
+        int generation = readValue<int>(file);
+        int stagnationCounter = readValue<int>(file);
+        long long savedSeedsUsed = readValue<long long>(file);
+        int pathsCount = readValue<int>(file);
+        long long pathBytes = sizeof(double) + sizeof(int) * (long long)size;
+        if (!file || size < 0 || pathsCount < 0 || size > getRemainingBytes(file) / (long long)sizeof(int)
+            || pathsCount > getRemainingBytes(file) / pathBytes)
         {
-            std::vector<Path> newPopulation;
-            std::vector<Path> children = makeChildren(population.size());
-
-            newPopulation.insert(newPopulation.end(), children.begin(), children.end());
-            mutate(newPopulation);
-            newPopulation.insert(newPopulation.end(), population.begin(), population.begin() + POPULATION_KEEP);
-            std::sort(newPopulation.begin(), newPopulation.end());
-            newPopulation.resize(populationSize);
-            population = std::move(newPopulation);
+            throw std::runtime_error("Corrupted TSP checkpoint: " + settings.resumePath);
+        }
+        bool isSameInstance = size == instance.getSize() && fingerprint == instance.getFingerprint();
 
-            if (population[0].totalWeight < lastBestWeight)
+        std::vector<int> nodes(size);
+        std::vector<char> isPresent(instance.getSize());
+        for (int i = 0; i < pathsCount; i++)
+        {
+            double weight = readValue<double>(file);
+            file.read(reinterpret_cast<char*>(nodes.data()), sizeof(int) * size);
+            if (i < populationSize)
             {
-                lastBestWeight = population[0].totalWeight;
-                stagnationCounter = 0;
+                int* slotNodes = population.getNodes(ranking[i]);
+                adaptPath(nodes, slotNodes, isPresent);
+                population.getWeight(ranking[i]) = isSameInstance ? weight : getPathWeight(slotNodes);
             }
-            else
+        }
+        if (isSameInstance)
+        {
+            int rngsCount = readValue<int>(file);
+            for (int k = 0; k < rngsCount && file; k++)
             {
-                stagnationCounter++;
-                if (stagnationCounter >= stagnationMax)
+                int stateLength = readValue<int>(file);
+                if (!file || stateLength < 0 || stateLength > getRemainingBytes(file))
                 {
-                    addRandomPopulation(populationSize * (100 - POPULATION_KEEP_RESTART_PERCENTAGE) / 100);
-                    stagnationCounter = 0;
+                    throw std::runtime_error("Corrupted TSP checkpoint: " + settings.resumePath);
+                }
+                std::string state(stateLength, '\0');
+                file.read(&state[0], state.size());
+                std::istringstream stateStream(state);
+                if (k == 0)
+                {
+                    stateStream >> rng;
+                }
+                else if (k - 1 < (int)workerRngs.size())
+                {
+                    stateStream >> workerRngs[k - 1];
                 }
             }
-            if (shouldPrint && (generation % printGenerationInterval == 0 || generation == maxGenerations - 1))
+            firstGeneration = generation + 1;
+            resumedStagnationCounter = stagnationCounter;
+            seedsUsed = savedSeedsUsed;
+        }
+        if (!file)
+        {
+            throw std::runtime_error("Truncated TSP checkpoint: " + settings.resumePath);
+        }
+        // A resumed population keeps its saved order, so the run continues exactly as it would have
+        if (!isSameInstance || pathsCount < populationSize)
+        {
+            selectBest(population, ranking, populationSize, populationSize);
+        }
+    }
+
+    // Keeps the order of the cities that exist in this instance and appends the missing ones
+    void adaptPath(const std::vector<int>& source, int* target, std::vector<char>& isPresent) const
+    {
+        int n = instance.getSize();
+        std::fill(isPresent.begin(), isPresent.end(), 0);
+        int length = 0;
+        for (int city : source)
+        {
+            if (city >= 0 && city < n && !isPresent[city])
+            {
+                isPresent[city] = 1;
+                target[length++] = city;
+            }
+        }
+        for (int city = 0; city < n; city++)
+        {
+            if (!isPresent[city])
             {
-                std::cout << population[0].totalWeight << std::endl;
+                target[length++] = city;
             }
         }
-        return population[0];
     }
 
-private:
+    template <typename T>
+    static void writeValue(std::ofstream& file, const T& value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static T readValue(std::ifstream& file)
+    {
+        T value{};
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
 
-    void mutate(std::vector<Path>& populationToMutate)
+    static long long getRemainingBytes(std::ifstream& file)
     {
-        for (auto & path : populationToMutate)
+        std::streampos position = file.tellg();
+        file.seekg(0, std::ios::end);
+        long long remaining = file.tellg() - position;
+        file.seekg(position);
+        return remaining;
+    }
+
+    // Phase times and counters so far, with the best and mean weight and the diversity of the population,
+    // the mean share of the best path's edges that a path does not have
+    void printStats(int generation, bool isFinal) const
+    {
+        PhaseStats total = stats;
+        for (const PhaseStats& workerStat : workerStats)
+        {
+            total.add(workerStat);
+        }
+        int size = instance.getSize();
+        const int* best = population.getNodes(ranking[0]);
+        std::vector<int> bestNext(size, -1);
+        std::vector<int> bestPrevious(size, -1);
+        for (int j = 0; j + 1 < size; j++)
+        {
+            bestNext[best[j]] = best[j + 1];
+            bestPrevious[best[j + 1]] = best[j];
+        }
+        double weightsSum = 0.0;
+        long long missingEdges = 0;
+        for (int i = 0; i < populationSize; i++)
         {
-            bool shouldMutateSwap = (rand() % 100) < MUTATION_PERCENTAGE;
-            if (shouldMutateSwap)
+            const int* nodes = population.getNodes(ranking[i]);
+            weightsSum += population.getWeight(ranking[i]);
+            for (int j = 0; j + 1 < size; j++)
             {
-                int size = path.nodes.size();
-                int index1 = rand() % size;
-                int index2 = rand() % size;
-                if (index1 == index2)
+                if (bestNext[nodes[j]] != nodes[j + 1] && bestPrevious[nodes[j]] != nodes[j + 1])
                 {
-                    index2 = (index2 + 1) % size;
+                    missingEdges++;
                 }
-                std::swap(path.nodes[index1], path.nodes[index2]);
-                path.totalWeight = getPathWeight(path.nodes);
             }
         }
+        double diversity = size > 1 ? (double)missingEdges / ((double)populationSize * (size - 1)) : 0.0;
+
+        std::cout << (isFinal ? "# GA_STATS_FINAL:" : "# GA_STATS:")
+                  << " generation=" << generation
+                  << " best=" << population.getWeight(ranking[0])
+                  << " mean=" << weightsSum / populationSize
+                  << " diversity=" << diversity
+                  << " evaluations=" << total.evaluations
+                  << " mutations=" << total.mutations
+                  << " restarts=" << total.restarts
+                  << " migrants=" << total.migrants
+                  << " crossover_ms=" << total.crossoverNs / 1000000
+                  << " local_search_ms=" << total.localSearchNs / 1000000
+                  << " selection_ms=" << total.selectionNs / 1000000
+                  << " restart_ms=" << total.restartNs / 1000000 << std::endl;
     }
 
-    Path tournamentSelect(const std::vector<Path>& candidates) const
+    // Change of the open path weight if the nodes at the two positions are swapped.
+    // Only the up to four edges around them change, so this is O(1).
+    double getSwapDelta(const int* nodes, int index1, int index2) const
     {
-        int tournamentSize = 3;
-        int bestIdx = rand() % populationSize;
-        for (int j = 1; j < tournamentSize - 1; j++)
+        if (index1 > index2)
         {
-            int currIdx = rand() % populationSize;
-            if (currIdx < bestIdx)
-            {
-                bestIdx = currIdx;
-            }
+            std::swap(index1, index2);
         }
-        return candidates[bestIdx];
+        int last = instance.getSize() - 1;
+        int node1 = nodes[index1];
+        int node2 = nodes[index2];
+        double delta = 0.0;
+        if (index1 > 0)
+        {
+            int before = nodes[index1 - 1];
+            delta += instance.getDistance(before, node2) - instance.getDistance(before, node1);
+        }
+        if (index2 < last)
+        {
+            int after = nodes[index2 + 1];
+            delta += instance.getDistance(node1, after) - instance.getDistance(node2, after);
+        }
+        if (index2 - index1 > 1)
+        {
+            int afterFirst = nodes[index1 + 1];
+            int beforeSecond = nodes[index2 - 1];
+            delta += instance.getDistance(node2, afterFirst) - instance.getDistance(node1, afterFirst);
+            delta += instance.getDistance(beforeSecond, node1) - instance.getDistance(beforeSecond, node2);
+        }
+        return delta;
+    }
+
+    double getPathWeight(const int* nodes) const
+    {
+        return instance.getPathWeight(nodes);
     }
 
-    std::vector<Path> makeChildren(int childrenCount)
+    Path bestPathBaseCase()
     {
-        std::vector<Path> children;
-        children.resize(childrenCount);
 
-        for(int i = 0; i < childrenCount; i++)
+        if (instance.getSize() == 0)
+        {
+            return {};
+        }
+        if (instance.getSize() == 1)
         {
-            Path parent1 = tournamentSelect(population);
-            Path parent2 = tournamentSelect(population);
-            Path child = makeChild(parent1, parent2);
-            children[i] = child;
+            return Path({0}, 0.0);
         }
-        return children;
+        return Path({0, 1}, instance.getDistance(0, 1));
+    }
+};
+
+// Single-slot mailbox swapped atomically, an unread migrant is replaced by a newer one
+class MigrationMailbox
+{
+private:
+    std::atomic<Path*> slot{nullptr};
+public:
+    ~MigrationMailbox()
+    {
+        delete slot.load();
     }
 
-    Path makeChild(const Path& parent1, const Path& parent2)
+    void send(const Path& path)
     {
-        int size = parent1.nodes.size();
-        int i = rand() % parent1.nodes.size();
-        int j = rand() % parent1.nodes.size();
-        while (i == j)
+        delete slot.exchange(new Path(path));
+    }
+
+    bool receive(Path& path)
+    {
+        std::unique_ptr<Path> received(slot.exchange(nullptr));
+        if (!received)
         {
-            j = rand() % parent1.nodes.size();
+            return false;
         }
-        if (i > j) std::swap(i, j);
-        std::vector<int> child1Nodes(parent1.nodes.size(), -1);
+        path = std::move(*received);
+        return true;
+    }
+};
 
-        std::vector<int> parent2Positions(size);
-        for (int index = 0; index < size; index++)
+// Independent populations on separate threads that send their best path to a neighbour on
+// the ring, or to a random island, every migrationInterval generations
+class IslandModel
+{
+public:
+    static Path findBestPath(const TSPInstance& instance, const TSPSettings& settings, bool shouldPrint)
+    {
+        int islandsCount = settings.islandsCount;
+        std::vector<MigrationMailbox> mailboxes(islandsCount);
+        std::vector<Path> bestPaths(islandsCount);
+        auto runIsland = [&](int island)
         {
-            parent2Positions[parent2.nodes[index]] = index;
-        }
+            TSPSettings islandSettings = settings;
+            islandSettings.threadsCount = 1;
+            islandSettings.collectTelemetry = settings.collectTelemetry && island == 0;
+            std::string islandSuffix = ".island" + std::to_string(island);
+            if (!settings.checkpointPath.empty())
+            {
+                islandSettings.checkpointPath += islandSuffix;
+            }
+            if (!settings.resumePath.empty())
+            {
+                islandSettings.resumePath += islandSuffix;
+            }
+            std::seed_seq islandSeed{settings.seed, static_cast<unsigned int>(island), 0x15u};
+            std::vector<unsigned int> islandSeedValue(2);
+            islandSeed.generate(islandSeedValue.begin(), islandSeedValue.end());
+            islandSettings.seed = islandSeedValue[0];
+            std::mt19937 migrationRng(islandSeedValue[1]);
 
-        std::vector<bool> child1Set(size, false);
-        for (int k = i; k <= j; k++)
+            TSPGeneticSolver solver(instance, islandSettings);
+            bestPaths[island] = solver.findBestPath(shouldPrint && island == 0,
+                                                    [&](TSPGeneticSolver& islandSolver, int generation)
+            {
+                if ((generation + 1) % settings.migrationInterval != 0)
+                {
+                    return;
+                }
+                int target = (island + 1) % islandsCount;
+                if (settings.topology == MigrationTopology::RANDOM)
+                {
+                    target = std::uniform_int_distribution<int>(0, islandsCount - 2)(migrationRng);
+                    target += target >= island ? 1 : 0;
+                }
+                mailboxes[target].send(islandSolver.getBestPath());
+                Path migrant;
+                if (mailboxes[island].receive(migrant))
+                {
+                    islandSolver.acceptMigrant(migrant);
+                }
+            });
+        };
+
+        std::vector<std::thread> islands;
+        for (int island = 1; island < islandsCount; island++)
+        {
+            islands.emplace_back(runIsland, island);
+        }
+        runIsland(0);
+        for (auto& island : islands)
         {
-            child1Nodes[k] = parent1.nodes[k];
-            child1Set[parent1.nodes[k]] = true;
+            island.join();
         }
+        return *std::min_element(bestPaths.begin(), bestPaths.end());
+    }
+};
 
-        int currentIndex1 = (j + 1) % size;
+const int TSPGeneticSolver::POPULATION_KEEP;
+const int TSPGeneticSolver::POPULATION_KEEP_RESTART_PERCENTAGE;
+const int TSPGeneticSolver::MAX_GENERATIONS;
+const int TSPGeneticSolver::STAGNATION_COEF;
+const int TSPGeneticSolver::GENERATIONS_TO_PRINT;
+const int TSPGeneticSolver::MUTATION_PERCENTAGE;
+const int TSPGeneticSolver::CHECKPOINT_VERSION;
+const char TSPGeneticSolver::CHECKPOINT_MAGIC[8] = {'T', 'S', 'P', 'C', 'K', 'P', 'T', '\0'};
 
-        for (int k = 0; k < size; k++)
+// Read-only view of a whole file, memory mapped where POSIX is available
+class MappedFile
+{
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    std::string contents;
+#endif
+public:
+    explicit MappedFile(const std::string& path)
+    {
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = contents.data();
+        size = contents.size();
+#else
+        int descriptor = open(path.c_str(), O_RDONLY);
+        struct stat fileStat;
+        if (descriptor < 0 || fstat(descriptor, &fileStat) != 0)
         {
-            int parent2Node = parent2.nodes[(j + 1 + k) % size];
-            if (!child1Set[parent2Node])
+            if (descriptor >= 0)
             {
-                child1Nodes[currentIndex1] = parent2Node;
-                currentIndex1 = (currentIndex1 + 1) % size;
+                close(descriptor);
             }
+            throw std::runtime_error("Cannot open " + path);
         }
-        double child1Weight = getPathWeight(child1Nodes);
-        return {child1Nodes, child1Weight};
+        size = fileStat.st_size;
+        if (size > 0)
+        {
+            void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping == MAP_FAILED)
+            {
+                close(descriptor);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(mapping);
+        }
+        close(descriptor);
+#endif
     }
 
-    void addRandomPopulation(int randomCount)
+    ~MappedFile()
     {
-        if (population.size() == populationSize)
+#ifndef _WIN32
+        if (size > 0)
         {
-            population.resize(populationSize - randomCount);
+            munmap(const_cast<char*>(data), size);
         }
-        std::vector<int> nodes(points.size());
+#endif
+    }
 
-        for (int j = 0; j < points.size(); j++)
-        {
-            nodes[j] = j;
-        }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const
+    {
+        return data;
+    }
+
+    const char* end() const
+    {
+        return data + size;
+    }
+};
+
+// Loads TSPLIB files of type EUC_2D and plain files with "x y" or "id x y" per line. Numbers are
+// parsed straight from the mapped file. Distances are not rounded to TSPLIB's nearest integers,
+// so path lengths come out slightly different from the published optima.
+class CoordinateLoader
+{
+private:
+    const char* current;
+    const char* end;
+public:
+    struct Result
+    {
+        std::vector<std::pair<double, double>> points;
+        std::vector<std::string> names;
+    };
 
-        for (int i = 0; i < randomCount; i++)
+    static Result load(const std::string& path)
+    {
+        MappedFile file(path);
+        CoordinateLoader loader(file.begin(), file.end());
+        Result result = loader.isTSPLib() ? loader.loadTSPLib() : loader.loadPlain();
+        if (result.points.empty())
         {
-            std::shuffle(nodes.begin(), nodes.end(), rng);
-            population.emplace_back(nodes, getPathWeight(nodes));
+            throw std::runtime_error("No coordinates in " + path);
         }
+        return result;
+    }
+
+private:
+    CoordinateLoader(const char* begin, const char* end) : current(begin), end(end) {}
 
-        std::sort(population.begin(), population.end());
+    bool isTSPLib() const
+    {
+        static const std::string marker = "NODE_COORD_SECTION";
+        return std::search(current, end, marker.begin(), marker.end()) != end;
     }
 
-    double getPathWeight(const std::vector<int> &nodes)
+    Result loadTSPLib()
     {
-        double totalWeight = 0.0;
-        for (size_t j = 0; j < nodes.size() - 1; j++)
+        Result result;
+        long long dimension = -1;
+        std::string weightType;
+        while (current < end)
         {
-            int from = nodes[j];
-            int to = nodes[j + 1];
-
-            totalWeight += distanceMatrix[from][to];
+            const char* lineEnd = std::find(current, end, '\n');
+            std::string line(current, lineEnd);
+            current = lineEnd < end ? lineEnd + 1 : end;
+            size_t colon = line.find(':');
+            std::string key = trim(line.substr(0, colon));
+            std::string value = colon != std::string::npos ? trim(line.substr(colon + 1)) : "";
+            if (key == "DIMENSION")
+            {
+                dimension = std::stoll(value);
+            }
+            else if (key == "EDGE_WEIGHT_TYPE")
+            {
+                weightType = value;
+            }
+            else if (key == "NODE_COORD_SECTION")
+            {
+                break;
+            }
         }
-        return totalWeight;
+        if (weightType.empty())
+        {
+            throw std::runtime_error("Missing EDGE_WEIGHT_TYPE in TSPLIB file");
+        }
+        if (weightType != "EUC_2D")
+        {
+            throw std::runtime_error("Unsupported EDGE_WEIGHT_TYPE '" + weightType + "', only EUC_2D is supported");
+        }
+        if (dimension < 0)
+        {
+            throw std::runtime_error("Missing DIMENSION in TSPLIB file");
+        }
+        // Every city takes at least a few bytes, which bounds the reservation for a bogus DIMENSION
+        long long maxCitiesCount = (end - current) / 6 + 1;
+        result.points.reserve(std::min(dimension, maxCitiesCount));
+        result.names.reserve(std::min(dimension, maxCitiesCount));
+        skipSpaces();
+        while (current < end && isNumberStart(*current))
+        {
+            const char* idBegin = current;
+            parseNumber();
+            std::string id(idBegin, current);
+            double x = parseNumber();
+            double y = parseNumber();
+            result.points.emplace_back(x, y);
+            result.names.push_back(std::move(id));
+            skipSpaces();
+        }
+        if ((long long)result.points.size() != dimension)
+        {
+            throw std::runtime_error("DIMENSION is " + std::to_string(dimension) + " but "
+                                     + std::to_string(result.points.size()) + " cities were read");
+        }
+        return result;
     }
 
-    Path bestPathBaseCase()
+    Result loadPlain()
     {
-
-        if (points.empty())
+        Result result;
+        skipSpaces();
+        const char* lineEnd = std::find(current, end, '\n');
+        int numbersPerLine = 0;
+        for (const char* c = current; c < lineEnd; )
         {
-            return {};
+            while (c < lineEnd && isSpace(*c)) c++;
+            if (c < lineEnd)
+            {
+                numbersPerLine++;
+            }
+            while (c < lineEnd && !isSpace(*c)) c++;
         }
-        if (points.size() == 1)
+        bool hasIds = numbersPerLine >= 3;
+        while (current < end && isNumberStart(*current))
         {
-            return Path({0}, 0.0);
+            std::string id;
+            if (hasIds)
+            {
+                const char* idBegin = current;
+                parseNumber();
+                id.assign(idBegin, current);
+            }
+            double x = parseNumber();
+            double y = parseNumber();
+            result.points.emplace_back(x, y);
+            result.names.push_back(hasIds ? std::move(id) : std::to_string(result.points.size()));
+            skipSpaces();
         }
-        double weight = calculateDistance(points[0].first, points[0].second,
-                                          points[1].first, points[1].second);
-        return Path({0, 1}, weight);
+        return result;
     }
 
-    std::vector<std::vector<double>> getDistanceMatrix(const std::vector<std::pair<double, double>> &vector)
+    static std::string trim(const std::string& str)
     {
-        int n = vector.size();
-        std::vector<std::vector<double>> matrix(n, std::vector<double>(n, 0.0));
-        for (int i = 0; i < n; i++)
+        size_t first = str.find_first_not_of(" \t\r");
+        size_t last = str.find_last_not_of(" \t\r");
+        return first == std::string::npos ? "" : str.substr(first, last - first + 1);
+    }
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    static bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static bool isNumberStart(char c)
+    {
+        return isDigit(c) || c == '-' || c == '+' || c == '.';
+    }
+
+    void skipSpaces()
+    {
+        while (current < end && isSpace(*current))
         {
-            for (int j = i + 1; j < n; j++)
+            current++;
+        }
+    }
+
+    // Decimal number with an optional sign, fraction and exponent. The digits are gathered into
+    // an integer mantissa and scaled once, which is exact enough for coordinates.
+    double parseNumber()
+    {
+        skipSpaces();
+        bool isNegative = false;
+        if (current < end && (*current == '-' || *current == '+'))
+        {
+            isNegative = *current == '-';
+            current++;
+        }
+        unsigned long long mantissa = 0;
+        int exponent = 0;
+        int digitsCount = 0;
+        bool hasDigits = false;
+        for (; current < end && isDigit(*current); current++, hasDigits = true)
+        {
+            if (digitsCount < 19)
             {
-                double dist = calculateDistance(vector[i].first, vector[i].second,
-                                                vector[j].first, vector[j].second);
-                matrix[i][j] = dist;
-                matrix[j][i] = dist;
+                mantissa = mantissa * 10 + (*current - '0');
+                digitsCount += mantissa > 0 ? 1 : 0;
+            }
+            else
+            {
+                exponent++;
             }
         }
-        return matrix;
+        if (current < end && *current == '.')
+        {
+            for (current++; current < end && isDigit(*current); current++, hasDigits = true)
+            {
+                if (digitsCount < 19)
+                {
+                    mantissa = mantissa * 10 + (*current - '0');
+                    digitsCount += mantissa > 0 ? 1 : 0;
+                    exponent--;
+                }
+            }
+        }
+        if (!hasDigits)
+        {
+            throw std::runtime_error("Malformed number in coordinate file");
+        }
+        if (current < end && (*current == 'e' || *current == 'E'))
+        {
+            current++;
+            bool isExponentNegative = false;
+            if (current < end && (*current == '-' || *current == '+'))
+            {
+                isExponentNegative = *current == '-';
+                current++;
+            }
+            int writtenExponent = 0;
+            for (; current < end && isDigit(*current); current++)
+            {
+                writtenExponent = std::min(writtenExponent * 10 + (*current - '0'), 10000);
+            }
+            exponent += isExponentNegative ? -writtenExponent : writtenExponent;
+        }
+        double value = static_cast<double>(mantissa);
+        if (exponent != 0 && mantissa != 0)
+        {
+            value = exponent > 0 ? value * pow10(exponent) : value / pow10(-exponent);
+        }
+        return isNegative ? -value : value;
     }
-};
 
-const int TSPGeneticSolver::POPULATION_KEEP;
-const int TSPGeneticSolver::POPULATION_KEEP_RESTART_PERCENTAGE;
-const int TSPGeneticSolver::MAX_GENERATIONS;
-const int TSPGeneticSolver::STAGNATION_COEF;
-const int TSPGeneticSolver::GENERATIONS_TO_PRINT;
-const int TSPGeneticSolver::MUTATION_PERCENTAGE;
+    static double pow10(int exponent)
+    {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        return exponent <= 22 ? powers[exponent] : std::pow(10.0, exponent);
+    }
+};
 
-std::vector<std::pair<double, double>> generateRandomPoints(int size)
+std::vector<std::pair<double, double>> generateRandomPoints(int size, unsigned int seed)
 {
     std::vector<std::pair<double, double>> points (size);
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(seed);
     std::uniform_real_distribution<> dis(0.0, 100.0);
     for (int i = 0; i < size; i++)
     {
@@ -283,39 +3125,153 @@ std::vector<std::pair<double, double>> generateRandomPoints(int size)
     return points;
 }
 
+TSPSettings getSettings()
+{
+    TSPSettings settings;
+    const char* mode_p = std::getenv("FMI_TSP_MODE");
+    if (mode_p != nullptr)
+    {
+        settings.mode = modeFromString(mode_p);
+    }
+    const char* kicks_p = std::getenv("FMI_TSP_KICKS");
+    settings.kicksCount = kicks_p != nullptr ? std::stoll(kicks_p) : -1;
+    const char* seedTour_p = std::getenv("FMI_TSP_SEED_TOUR");
+    settings.isSeededByLocalSearch = seedTour_p != nullptr && std::string(seedTour_p) == "1";
+    const char* seeding_p = std::getenv("FMI_TSP_SEEDING");
+    if (seeding_p != nullptr)
+    {
+        settings.seeding = seedingFromString(seeding_p);
+    }
+    const char* memetic_p = std::getenv("FMI_TSP_MEMETIC");
+    settings.isMemetic = memetic_p != nullptr && std::string(memetic_p) == "1";
+    const char* threads_p = std::getenv("FMI_THREADS");
+    settings.threadsCount = threads_p != nullptr ? std::stoi(threads_p) : 1;
+    if (settings.threadsCount <= 0)
+    {
+        settings.threadsCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const char* seed_p = std::getenv("FMI_SEED");
+    settings.seed = seed_p != nullptr ? static_cast<unsigned int>(std::stoul(seed_p)) : std::random_device()();
+    const char* crossover_p = std::getenv("FMI_TSP_CROSSOVER");
+    if (crossover_p != nullptr)
+    {
+        settings.crossover = crossoverFromString(crossover_p);
+    }
+    const char* time_p = std::getenv("FMI_TSP_TIME_MS");
+    settings.timeLimitMs = time_p != nullptr ? std::stoll(time_p) : 0;
+    const char* improvement_p = std::getenv("FMI_TSP_MIN_IMPROVEMENT");
+    settings.minImprovement = improvement_p != nullptr ? std::stod(improvement_p) : 0.0;
+    const char* window_p = std::getenv("FMI_TSP_IMPROVEMENT_WINDOW_MS");
+    if (window_p != nullptr)
+    {
+        settings.improvementWindowMs = std::stoll(window_p);
+    }
+    const char* trace_p = std::getenv("FMI_TSP_TRACE");
+    settings.isTracing = trace_p != nullptr && std::string(trace_p) == "1";
+    const char* checkpoint_p = std::getenv("FMI_TSP_CHECKPOINT");
+    settings.checkpointPath = checkpoint_p != nullptr ? checkpoint_p : "";
+    const char* checkpointInterval_p = std::getenv("FMI_TSP_CHECKPOINT_INTERVAL");
+    if (checkpointInterval_p != nullptr)
+    {
+        settings.checkpointInterval = std::max(1, std::stoi(checkpointInterval_p));
+    }
+    const char* resume_p = std::getenv("FMI_TSP_RESUME");
+    settings.resumePath = resume_p != nullptr ? resume_p : "";
+    const char* telemetry_p = std::getenv("FMI_TSP_STATS");
+    settings.collectTelemetry = telemetry_p != nullptr && std::string(telemetry_p) == "1";
+    const char* islands_p = std::getenv("FMI_TSP_ISLANDS");
+    settings.islandsCount = islands_p != nullptr ? std::stoi(islands_p) : 1;
+    if (settings.islandsCount <= 0)
+    {
+        settings.islandsCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const char* interval_p = std::getenv("FMI_TSP_MIGRATION_INTERVAL");
+    settings.migrationInterval = std::max(1, interval_p != nullptr ? std::stoi(interval_p) : settings.migrationInterval);
+    const char* topology_p = std::getenv("FMI_TSP_TOPOLOGY");
+    if (topology_p != nullptr)
+    {
+        settings.topology = topologyFromString(topology_p);
+    }
+    return settings;
+}
+
 int main()
 {
     std::cout << std::setprecision(std::numeric_limits<double>::max_digits10);
     bool isTimeOnly = getIsTimeOnly();
-    std::string name;
-    std::cin >> name;
+    TSPSettings settings = getSettings();
+    std::string inputFile = getInputFile();
     std::vector<std::pair<double, double>> points;
     std::vector<std::string> pointNames = {};
     bool namedSolution = false;
-    try
+    if (!inputFile.empty())
     {
-        int n = std::stoi(name);
-        points = generateRandomPoints(n);
+        CoordinateLoader::Result loaded = CoordinateLoader::load(inputFile);
+        points = std::move(loaded.points);
+        pointNames = std::move(loaded.names);
+        namedSolution = true;
     }
-    catch (std::invalid_argument&)
+    else
     {
-        namedSolution = true;
-        int n;
-        std::cin >> n;
-        points.reserve(n);
-        pointNames.reserve(n);
-        for (int i = 0; i < n; i++)
+        std::string name;
+        std::cin >> name;
+        try
         {
-            std::string pointName;
-            double x, y;
-            std::cin >> pointName >> x >> y;
-            points.emplace_back(x, y);
-            pointNames.push_back(pointName);
+            int n = std::stoi(name);
+            points = generateRandomPoints(n, settings.seed);
+        }
+        catch (std::invalid_argument&)
+        {
+            namedSolution = true;
+            int n;
+            std::cin >> n;
+            points.reserve(n);
+            pointNames.reserve(n);
+            for (int i = 0; i < n; i++)
+            {
+                std::string pointName;
+                double x, y;
+                std::cin >> pointName >> x >> y;
+                points.emplace_back(x, y);
+                pointNames.push_back(pointName);
+            }
         }
     }
 
-    TSPGeneticSolver solver(points);
-    Path bestPath = solver.findBestPath(!isTimeOnly);
+    TSPInstance instance(points, getIsMatrixFree(), getNeighborsCount());
+    if (getIsGapBenchmark() && settings.mode != SolverMode::EXACT)
+    {
+        if (instance.getSize() > HeldKarpSolver::getMaxSize())
+        {
+            throw std::invalid_argument("FMI_TSP_GAP needs the exact optimum, which is limited to "
+                                        + std::to_string(HeldKarpSolver::getMaxSize()) + " cities");
+        }
+        // The optimum is computed first so that the trace of the chosen solver reports the gap to it
+        Path optimum = HeldKarpSolver(instance, settings.threadsCount).findBestPath();
+        std::cout << "# OPTIMUM: " << optimum.totalWeight << std::endl;
+        settings.referenceWeight = optimum.totalWeight;
+        settings.isTracing = true;
+        settings.startTime = std::chrono::steady_clock::now();
+    }
+    Path bestPath;
+    if (settings.mode == SolverMode::EXACT)
+    {
+        bestPath = HeldKarpSolver(instance, settings.threadsCount).findBestPath();
+    }
+    else if (settings.mode == SolverMode::LOCAL_SEARCH)
+    {
+        IteratedLocalSearch solver(instance, settings);
+        bestPath = solver.findBestPath(!isTimeOnly);
+    }
+    else if (settings.islandsCount > 1 && instance.getSize() > 2)
+    {
+        bestPath = IslandModel::findBestPath(instance, settings, !isTimeOnly);
+    }
+    else
+    {
+        TSPGeneticSolver solver(instance, settings);
+        bestPath = solver.findBestPath(!isTimeOnly);
+    }
     std::cout << std::endl;
     if (!isTimeOnly)
     {